@@ -0,0 +1,132 @@
+// Throughput of the ConcurrentHashMap against a std::unordered_map protected by Mutex + AutoLock.
+//
+// Standalone program, it is not part of the CMake build:
+//
+//   g++ -std=c++11 -O2 -I../include concurrent_hash_map.cpp -o concurrent_hash_map -lpthread
+//
+// The map is filled with 'key_count' keys. N threads (N = 1, 2, 4, ..., 64) run
+// the same total number of random operations:
+//
+// - read-heavy: 95% find, 5% insertOrAssign
+// - mixed: 50% find, 50% insertOrAssign
+//
+// The assignments replace existing keys, so the map size does not change during the run.
+// A ConcurrentHashMap assignment allocates a new node and retires the old one,
+// the std::unordered_map assigns in place: the gain is in the reads, when the
+// threads run in parallel on different cores.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+#include <InteractiveToolkit/Platform/Core/ConcurrentHashMap.h>
+
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+static const uint32_t key_count = 1 << 16;
+static const uint32_t total_operations = 1 << 22;
+
+struct LockedUnorderedMap
+{
+    Platform::Mutex mutex;
+    std::unordered_map<uint32_t, uint64_t> map;
+
+    bool find(uint32_t key, uint64_t *out)
+    {
+        Platform::AutoLock autoLock(&mutex);
+        auto it = map.find(key);
+        if (it == map.end())
+            return false;
+        *out = it->second;
+        return true;
+    }
+    void insertOrAssign(uint32_t key, uint64_t value)
+    {
+        Platform::AutoLock autoLock(&mutex);
+        map[key] = value;
+    }
+};
+
+struct ShardedMap
+{
+    Platform::ConcurrentHashMap<uint32_t, uint64_t> map;
+
+    bool find(uint32_t key, uint64_t *out) { return map.find(key, out); }
+    void insertOrAssign(uint32_t key, uint64_t value) { map.insertOrAssign(key, value); }
+};
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+template <typename Map>
+static double run(int thread_count, uint32_t read_percent)
+{
+    Map map;
+    for (uint32_t k = 0; k < key_count; k++)
+        map.insertOrAssign(k, k);
+
+    uint32_t per_thread = total_operations / (uint32_t)thread_count;
+    std::atomic<uint64_t> missing(0);
+    std::vector<Platform::Thread *> threads;
+    for (int t = 0; t < thread_count; t++)
+        threads.push_back(new Platform::Thread([&map, &missing, per_thread, read_percent, t]()
+                                               {
+                                                   uint32_t state = 0x9e3779b9u * (uint32_t)(t + 1);
+                                                   uint64_t not_found = 0;
+                                                   for (uint32_t i = 0; i < per_thread; i++)
+                                                   {
+                                                       uint32_t r = xorshift32(&state);
+                                                       uint32_t key = r & (key_count - 1);
+                                                       if ((r >> 16) % 100 < read_percent)
+                                                       {
+                                                           uint64_t value;
+                                                           if (!map.find(key, &value))
+                                                               not_found++;
+                                                       }
+                                                       else
+                                                           map.insertOrAssign(key, i);
+                                                   }
+                                                   missing += not_found;
+                                               }));
+
+    auto time_begin = std::chrono::steady_clock::now();
+    for (auto thread : threads)
+        thread->start();
+    for (auto thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+
+    if (missing.load() != 0)
+        printf("find error\n");
+
+    return (double)(per_thread * (uint32_t)thread_count) / seconds;
+}
+
+static void workload(const char *name, uint32_t read_percent)
+{
+    printf("%s (%u%% find)\n", name, read_percent);
+    printf("%10s %26s %26s\n", "threads", "unordered_map+Mutex Mop/s", "ConcurrentHashMap Mop/s");
+    for (int threads = 1; threads <= 64; threads *= 2)
+    {
+        double locked_rate = run<LockedUnorderedMap>(threads, read_percent);
+        double sharded_rate = run<ShardedMap>(threads, read_percent);
+        printf("%10d %26.2f %26.2f\n", threads, locked_rate / 1e6, sharded_rate / 1e6);
+    }
+}
+
+int main()
+{
+    printf("keys: %u, operations per run: %u\n", key_count, total_operations);
+    workload("read-heavy", 95);
+    workload("mixed", 50);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Throughput of the MPMCQueue against the ObjectQueue (Mutex + SmartVector + Semaphore).
+//
+// Standalone program, it is not part of the CMake build:
+//
+//   g++ -std=c++11 -O2 -I../include mpmc_vs_object_queue.cpp -o mpmc_vs_object_queue -lpthread
+//
+// P producers and P consumers exchange the same total number of elements
+// through a blocking queue, for P = 1, 2, 4, ..., 64.
+//
+// The ObjectQueue is unbounded: its producers never wait. The MPMCQueue
+// producers park when the ring is full, so the result depends on the
+// number of cores available to run producers and consumers at the same time.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+#include <InteractiveToolkit/Platform/Core/ObjectQueue.h>
+#include <InteractiveToolkit/Platform/Core/MPMCQueue.h>
+
+#include <chrono>
+#include <cstdio>
+
+static const uint32_t total_elements = 1 << 20;
+static const uint32_t mpmc_capacity = 1024;
+
+template <typename Queue>
+static double run(Queue *queue, int pairs)
+{
+    uint32_t per_thread = total_elements / (uint32_t)pairs;
+    std::atomic<int64_t> checksum(0);
+    std::vector<Platform::Thread *> threads;
+
+    for (int p = 0; p < pairs; p++)
+        threads.push_back(new Platform::Thread([queue, per_thread]()
+                                               {
+                                                   for (uint32_t i = 0; i < per_thread; i++)
+                                                       queue->enqueue(i + 1);
+                                               }));
+    for (int c = 0; c < pairs; c++)
+        threads.push_back(new Platform::Thread([queue, per_thread, &checksum]()
+                                               {
+                                                   int64_t sum = 0;
+                                                   for (uint32_t i = 0; i < per_thread; i++)
+                                                       sum += queue->dequeue();
+                                                   checksum += sum;
+                                               }));
+
+    auto time_begin = std::chrono::steady_clock::now();
+    for (auto thread : threads)
+        thread->start();
+    for (auto thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+
+    int64_t expected = (int64_t)pairs * (int64_t)per_thread * (int64_t)(per_thread + 1) / 2;
+    if (checksum.load() != expected)
+        printf("checksum error\n");
+
+    return (double)(per_thread * (uint32_t)pairs) / seconds;
+}
+
+int main()
+{
+    printf("elements: %u, MPMCQueue capacity: %u\n", total_elements, mpmc_capacity);
+    printf("%10s %18s %18s\n", "pairs", "ObjectQueue Mop/s", "MPMCQueue Mop/s");
+    for (int pairs = 1; pairs <= 64; pairs *= 2)
+    {
+        Platform::ObjectQueue<uint32_t> object_queue;
+        Platform::MPMCQueue<uint32_t> mpmc_queue(mpmc_capacity);
+        double object_queue_rate = run(&object_queue, pairs);
+        double mpmc_rate = run(&mpmc_queue, pairs);
+        printf("%10d %18.2f %18.2f\n", pairs, object_queue_rate / 1e6, mpmc_rate / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Latency of the futex Platform::Mutex and Platform::Semaphore against the
+// previous linux path (recursive pthread_mutex_t and sem_t).
+//
+// Standalone program, it is not part of the CMake build (linux only):
+//
+//   g++ -std=c++11 -O2 -I../include mutex_semaphore_latency.cpp -o mutex_semaphore_latency -lpthread
+//
+// - lock/unlock: one thread (uncontended) and 4 threads incrementing a shared counter.
+// - signal/wait: two threads ping-pong with two semaphores, time per round trip.
+//
+// The sem_t column calls sem_wait/sem_post directly, without the interrupt
+// bookkeeping the previous Semaphore did around them: it is a lower bound of the old cost.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <chrono>
+#include <cstdio>
+
+struct PthreadMutex
+{
+    pthread_mutex_t mutex;
+
+    PthreadMutex()
+    {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+    }
+    ~PthreadMutex()
+    {
+        pthread_mutex_destroy(&mutex);
+    }
+    void lock() { pthread_mutex_lock(&mutex); }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+};
+
+struct PosixSemaphore
+{
+    sem_t semaphore;
+
+    PosixSemaphore() { sem_init(&semaphore, 0, 0); }
+    ~PosixSemaphore() { sem_destroy(&semaphore); }
+    void release() { sem_post(&semaphore); }
+    void blockingAcquire()
+    {
+        while (sem_wait(&semaphore) != 0)
+            ;
+    }
+};
+
+struct FutexSemaphore
+{
+    Platform::Semaphore semaphore;
+
+    void release() { semaphore.release(); }
+    void blockingAcquire() { semaphore.blockingAcquire(true); }
+};
+
+static double elapsedNs(const std::chrono::steady_clock::time_point &begin)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template <typename MutexType>
+static double lockUnlockNs(int thread_count, uint32_t iterations)
+{
+    MutexType mutex;
+    int64_t counter = 0;
+    std::vector<Platform::Thread *> threads;
+    for (int t = 0; t < thread_count; t++)
+        threads.push_back(new Platform::Thread([&mutex, &counter, iterations]()
+                                               {
+                                                   for (uint32_t i = 0; i < iterations; i++)
+                                                   {
+                                                       mutex.lock();
+                                                       counter++;
+                                                       mutex.unlock();
+                                                   }
+                                               }));
+
+    auto begin = std::chrono::steady_clock::now();
+    for (auto thread : threads)
+        thread->start();
+    for (auto thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    double ns = elapsedNs(begin);
+
+    if (counter != (int64_t)thread_count * (int64_t)iterations)
+        printf("counter error\n");
+    return ns / ((double)thread_count * (double)iterations);
+}
+
+template <typename SemaphoreType>
+static double pingPongNs(uint32_t round_trips)
+{
+    SemaphoreType ping, pong;
+    Platform::Thread other([&ping, &pong, round_trips]()
+                           {
+                               for (uint32_t i = 0; i < round_trips; i++)
+                               {
+                                   ping.blockingAcquire();
+                                   pong.release();
+                               }
+                           });
+    other.start();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < round_trips; i++)
+    {
+        ping.release();
+        pong.blockingAcquire();
+    }
+    double ns = elapsedNs(begin);
+    other.wait();
+    return ns / (double)round_trips;
+}
+
+int main()
+{
+    const uint32_t iterations = 2000000;
+    const uint32_t round_trips = 100000;
+
+    printf("%-28s %16s %16s\n", "", "pthread/sem_t ns", "Platform ns");
+    printf("%-28s %16.2f %16.2f\n", "lock/unlock (1 thread)",
+           lockUnlockNs<PthreadMutex>(1, iterations),
+           lockUnlockNs<Platform::Mutex>(1, iterations));
+    printf("%-28s %16.2f %16.2f\n", "lock/unlock (4 threads)",
+           lockUnlockNs<PthreadMutex>(4, iterations / 4),
+           lockUnlockNs<Platform::Mutex>(4, iterations / 4));
+    printf("%-28s %16.2f %16.2f\n", "signal/wait round trip",
+           pingPongNs<PosixSemaphore>(round_trips),
+           pingPongNs<FutexSemaphore>(round_trips));
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Allocation count of the SmartVector storage modes and of the ObjectQueue.
+//
+// Standalone program, it is not part of the CMake build:
+//
+//   g++ -std=c++11 -O2 -I../include object_queue_alloc.cpp -o object_queue_alloc -lpthread
+//
+// Each round creates a container, pushes 'depth' elements and drains it.
+// That is the usual life of a short lived work queue.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+#include <InteractiveToolkit/Platform/Core/ObjectQueue.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocation_count(0);
+
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *result = malloc((size == 0) ? 1 : size);
+    if (result == nullptr)
+        throw std::bad_alloc();
+    return result;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static const int rounds = 200000;
+
+template <typename Vector>
+static void benchVector(const char *name, int depth)
+{
+    uint64_t allocations_begin = allocation_count.load();
+    auto time_begin = std::chrono::steady_clock::now();
+
+    int64_t sum = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        Vector queue;
+        for (int i = 0; i < depth; i++)
+            queue.push_back(i);
+        while (queue.size() > 0)
+        {
+            sum += queue.front();
+            queue.pop_front();
+        }
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_begin).count();
+    uint64_t allocations = allocation_count.load() - allocations_begin;
+    printf("%-34s depth %3d: %8.3f allocations/round %8.1f ns/round (sum %lld)\n",
+           name, depth, (double)allocations / rounds, ns / rounds, (long long)sum);
+}
+
+static void benchObjectQueue(int depth)
+{
+    uint64_t allocations_begin = allocation_count.load();
+    auto time_begin = std::chrono::steady_clock::now();
+
+    int64_t sum = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        Platform::ObjectQueue<int> queue(false);
+        for (int i = 0; i < depth; i++)
+            queue.enqueue(i);
+        bool empty = false;
+        while (true)
+        {
+            int v = queue.dequeue(&empty);
+            if (empty)
+                break;
+            sum += v;
+        }
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_begin).count();
+    uint64_t allocations = allocation_count.load() - allocations_begin;
+    printf("%-34s depth %3d: %8.3f allocations/round %8.1f ns/round (sum %lld)\n",
+           "ObjectQueue<int> (inline 8)", depth, (double)allocations / rounds, ns / rounds, (long long)sum);
+}
+
+int main()
+{
+    const int depths[] = {1, 4, 8, 32};
+    for (int depth : depths)
+    {
+        benchVector<Platform::SmartVector<int>>("SmartVector<int> (heap)", depth);
+        benchVector<Platform::SmartVector<int, 8, true>>("SmartVector<int, 8, true> (inline)", depth);
+        benchObjectQueue(depth);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+// Throughput of QueueIPC::writeBatch/readBatch against write/read called one message at a time.
+//
+// Standalone program, it is not part of the CMake build (linux/macOS, it uses fork):
+//
+//   g++ -std=c++11 -O2 -I../include queue_ipc_batch.cpp -o queue_ipc_batch -lpthread
+//
+// A child process writes the messages and the parent process reads them,
+// for payloads of 32B, 256B and 4KB. The batches have up to 32 messages.
+// The time is measured in the reader, from the first message received to the last one.
+//
+// A blocked QueueIPC reader or writer polls the queue every 1 ms. The queue
+// holds 8192 messages, so the run measures the cost of the lock and copy per
+// message instead of the polling interval.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+
+static const char *queue_name = "itk_bench_queue_ipc_batch";
+static const uint32_t queue_size = 8192;
+static const uint32_t batch_size = 32;
+
+static void fillPayload(Platform::ObjectBuffer *buffer, uint32_t payload_size, uint32_t index)
+{
+    buffer->setSize(payload_size);
+    memset(buffer->data, (int)(index & 0xff), payload_size);
+}
+
+static bool checkPayload(const Platform::ObjectBuffer &buffer, uint32_t payload_size, uint32_t index)
+{
+    return buffer.size == payload_size &&
+           buffer.data[0] == (uint8_t)(index & 0xff) &&
+           buffer.data[payload_size - 1] == (uint8_t)(index & 0xff);
+}
+
+static void writer(uint32_t payload_size, uint32_t message_count, bool batch)
+{
+    Platform::IPC::QueueIPC queue(queue_name, Platform::IPC::QueueIPC_WRITE, queue_size, payload_size);
+    std::vector<Platform::ObjectBuffer> buffers(batch_size);
+
+    uint32_t sent = 0;
+    while (sent < message_count)
+    {
+        if (batch)
+        {
+            uint32_t count = std::min(batch_size, message_count - sent);
+            for (uint32_t i = 0; i < count; i++)
+                fillPayload(&buffers[i], payload_size, sent + i);
+            // writeBatch may write only the start of the batch
+            uint32_t written = 0;
+            while (written < count)
+                written += queue.writeBatch(&buffers[written], count - written);
+            sent += count;
+        }
+        else
+        {
+            fillPayload(&buffers[0], payload_size, sent);
+            queue.write(buffers[0]);
+            sent++;
+        }
+    }
+}
+
+static double reader(uint32_t payload_size, uint32_t message_count, bool batch)
+{
+    Platform::IPC::QueueIPC queue(queue_name, Platform::IPC::QueueIPC_READ, queue_size, payload_size);
+    std::vector<Platform::ObjectBuffer> buffers(batch_size);
+
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    std::chrono::steady_clock::time_point time_begin;
+    while (received < message_count)
+    {
+        uint32_t count;
+        if (batch)
+            count = queue.readBatch(&buffers[0], batch_size);
+        else
+            count = queue.read(&buffers[0]) ? 1 : 0;
+        if (count > 0 && received == 0)
+            time_begin = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++, received++)
+            if (!checkPayload(buffers[i], payload_size, received))
+                errors++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+
+    if (errors != 0)
+        printf("payload error\n");
+
+    // the first message is not timed
+    return (double)(message_count - 1) / seconds;
+}
+
+static double run(uint32_t payload_size, uint32_t message_count, bool batch)
+{
+    Platform::IPC::QueueIPC::force_shm_unlink(queue_name);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        writer(payload_size, message_count, batch);
+        _exit(0);
+    }
+    double rate = reader(payload_size, message_count, batch);
+    int status;
+    waitpid(pid, &status, 0);
+    return rate;
+}
+
+int main()
+{
+    const uint32_t payload_sizes[] = {32, 256, 4096};
+    const uint32_t message_count = 200000;
+
+    printf("messages per run: %u, queue size: %u, batch size: %u\n", message_count, queue_size, batch_size);
+    printf("%10s %22s %22s\n", "payload", "write/read Mmsg/s", "batch Mmsg/s");
+    for (uint32_t payload_size : payload_sizes)
+    {
+        double single_rate = run(payload_size, message_count, false);
+        double batch_rate = run(payload_size, message_count, true);
+        printf("%9uB %22.3f %22.3f\n", payload_size, single_rate / 1e6, batch_rate / 1e6);
+    }
+    Platform::IPC::QueueIPC::force_shm_unlink(queue_name);
+    return 0;
+}
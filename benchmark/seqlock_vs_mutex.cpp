@@ -0,0 +1,154 @@
+// Read throughput of the SeqLock (and of the Snapshot) against a struct protected by Mutex + AutoLock.
+//
+// Standalone program, it is not part of the CMake build:
+//
+//   g++ -std=c++11 -O2 -I../include seqlock_vs_mutex.cpp -o seqlock_vs_mutex -lpthread
+//
+// 1 writer updates the shared state in a loop while N readers copy it,
+// for N = 1, 2, 4, ..., 64. Each run lasts a fixed time and reports the
+// total reads/s of the readers and the writes/s of the writer.
+//
+// The Snapshot is a single reader primitive: it is measured only with N = 1.
+
+#include <InteractiveToolkit/InteractiveToolkit.h>
+#include <InteractiveToolkit/Platform/Core/SeqLock.h>
+#include <InteractiveToolkit/Platform/Core/Snapshot.h>
+
+#include <chrono>
+#include <cstdio>
+
+struct State
+{
+    uint64_t a, b, c, d;
+};
+
+static State makeState(uint64_t v)
+{
+    State result = {v, v, v, v};
+    return result;
+}
+
+static bool consistent(const State &s)
+{
+    return s.a == s.b && s.b == s.c && s.c == s.d;
+}
+
+struct MutexState
+{
+    Platform::Mutex mutex;
+    State state;
+
+    MutexState() : state(makeState(0)) {}
+    void write(const State &v)
+    {
+        Platform::AutoLock autoLock(&mutex);
+        state = v;
+    }
+    State read()
+    {
+        Platform::AutoLock autoLock(&mutex);
+        return state;
+    }
+};
+
+struct SeqLockState
+{
+    Platform::SeqLock<State> seqlock;
+
+    SeqLockState() : seqlock(makeState(0)) {}
+    void write(const State &v) { seqlock.write(v); }
+    State read() { return seqlock.read(); }
+};
+
+struct SnapshotState
+{
+    Platform::Snapshot<State> snapshot;
+
+    SnapshotState() : snapshot(makeState(0)) {}
+    void write(const State &v) { snapshot.write(v); }
+    State read() { return snapshot.read(); }
+};
+
+static const int run_ms = 200;
+
+struct Result
+{
+    double reads_per_second;
+    double writes_per_second;
+};
+
+template <typename Shared>
+static Result run(int reader_count)
+{
+    Shared shared;
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> total_reads(0);
+    std::atomic<uint64_t> total_writes(0);
+    std::atomic<uint64_t> errors(0);
+    std::vector<Platform::Thread *> threads;
+
+    threads.push_back(new Platform::Thread([&]()
+                                           {
+                                               uint64_t v = 0;
+                                               while (running.load(std::memory_order_relaxed))
+                                                   shared.write(makeState(++v));
+                                               total_writes += v;
+                                           }));
+    for (int r = 0; r < reader_count; r++)
+        threads.push_back(new Platform::Thread([&]()
+                                               {
+                                                   uint64_t reads = 0;
+                                                   uint64_t bad = 0;
+                                                   while (running.load(std::memory_order_relaxed))
+                                                   {
+                                                       if (!consistent(shared.read()))
+                                                           bad++;
+                                                       reads++;
+                                                   }
+                                                   total_reads += reads;
+                                                   errors += bad;
+                                               }));
+
+    for (auto thread : threads)
+        thread->start();
+    Platform::Sleep::millis(run_ms);
+    running = false;
+    for (auto thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+
+    if (errors.load() != 0)
+        printf("torn read error\n");
+
+    Result result;
+    result.reads_per_second = (double)total_reads.load() * 1000.0 / (double)run_ms;
+    result.writes_per_second = (double)total_writes.load() * 1000.0 / (double)run_ms;
+    return result;
+}
+
+int main()
+{
+    printf("1 writer, %d ms per run\n", run_ms);
+    printf("%8s %20s %20s %20s\n", "readers", "Mutex Mreads/s", "SeqLock Mreads/s", "Snapshot Mreads/s");
+    for (int readers = 1; readers <= 64; readers *= 2)
+    {
+        Result mutex_result = run<MutexState>(readers);
+        Result seqlock_result = run<SeqLockState>(readers);
+        if (readers == 1)
+        {
+            Result snapshot_result = run<SnapshotState>(readers);
+            printf("%8d %20.2f %20.2f %20.2f\n", readers,
+                   mutex_result.reads_per_second / 1e6,
+                   seqlock_result.reads_per_second / 1e6,
+                   snapshot_result.reads_per_second / 1e6);
+        }
+        else
+            printf("%8d %20.2f %20.2f %20s\n", readers,
+                   mutex_result.reads_per_second / 1e6,
+                   seqlock_result.reads_per_second / 1e6,
+                   "-");
+    }
+    return 0;
+}
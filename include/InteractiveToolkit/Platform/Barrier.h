@@ -0,0 +1,138 @@
+#pragma once
+
+//#include "platform_common.h"
+#include "../common.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "Sleep.h"
+#include "Core/Futex.h"
+
+// number of checks before parking the thread in the futex
+#ifndef ITK_BARRIER_SPIN_COUNT
+#define ITK_BARRIER_SPIN_COUNT 2048
+#endif
+
+namespace Platform
+{
+
+    /// \brief Reusable barrier for a fixed number of threads.
+    ///
+    /// Each thread calls wait() at the end of a phase. The last thread to arrive
+    /// starts the next phase and releases the others.
+    ///
+    /// The waiting threads spin (spin_count checks) before parking in a futex,
+    /// so short phases do not pay a context switch per step.
+    ///
+    /// When a waiting thread is interrupted, wait returns false. Its arrival
+    /// is still counted, so the other threads are not blocked by it.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::Barrier barrier(thread_count);
+    ///
+    /// // each worker thread
+    /// for (int pass = 0; pass < 4; pass++) {
+    ///     radixPass(pass, thread_index);
+    ///     if (!barrier.wait())
+    ///         break; // interrupted
+    /// }
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class Barrier
+    {
+        uint32_t count;
+        uint32_t spin_count;
+
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> arrived;
+        // value = (phase << 1) | waiters bit
+        //
+        // the waiters bit is in the same word of the phase: the last thread
+        // starts the next phase with one atomic operation and does not read
+        // the barrier after it (a released thread may destroy it)
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> phase;
+
+        static const uint32_t WaitersBit = 1;
+        static const uint32_t PhaseOne = 2;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        Barrier(const Barrier &v) = delete;
+        Barrier &operator=(const Barrier &v) = delete;
+
+        /// \brief Construct the barrier
+        ///
+        /// \param count number of threads of each phase
+        /// \param spin_count number of checks before parking (0 parks immediately)
+        ///
+        Barrier(uint32_t count, uint32_t spin_count = ITK_BARRIER_SPIN_COUNT)
+        {
+            ITK_ABORT(count == 0, "Barrier count must be greater than zero.\n");
+            this->count = count;
+            this->spin_count = spin_count;
+            arrived = 0;
+            phase = 0;
+        }
+
+        /// \brief Arrive at the barrier and wait all threads of the phase
+        ///
+        /// \param ignore_signal if true, the wait is not interrupted by Thread::interrupt()
+        /// \return false if the current thread was interrupted before the phase completed
+        ///
+        bool wait(bool ignore_signal = false)
+        {
+            uint32_t current_phase = phase.load(std::memory_order_acquire) >> 1;
+
+            if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count)
+            {
+                // nobody arrives in the next phase before it starts
+                arrived.store(0, std::memory_order_relaxed);
+                std::atomic<uint32_t> *address = &phase;
+                uint32_t v = address->load(std::memory_order_relaxed);
+                while (!address->compare_exchange_weak(v, (v + PhaseOne) & ~WaitersBit))
+                    ;
+                if ((v & WaitersBit) != 0)
+                    Futex::wakeAll(address);
+                return true;
+            }
+
+            for (uint32_t i = 0; i < spin_count; i++)
+            {
+                if ((phase.load(std::memory_order_acquire) >> 1) != current_phase)
+                    return true;
+                Sleep::cpuRelax();
+            }
+
+            uint32_t v = phase.load(std::memory_order_acquire);
+            while ((v >> 1) == current_phase)
+            {
+                // mark the word before parking, the last thread of the phase will wake
+                if ((v & WaitersBit) == 0)
+                {
+                    if (!phase.compare_exchange_weak(v, v | WaitersBit, std::memory_order_acquire, std::memory_order_acquire))
+                        continue;
+                    v |= WaitersBit;
+                }
+                if (Futex::waitInterruptible(&phase, v, UINT32_MAX, ignore_signal) == FutexWaitResult::Interrupted &&
+                    (phase.load(std::memory_order_acquire) >> 1) == current_phase)
+                    return false;
+                v = phase.load(std::memory_order_acquire);
+            }
+            return true;
+        }
+
+        // number of completed phases
+        uint32_t getPhase() const
+        {
+            return phase.load(std::memory_order_acquire) >> 1;
+        }
+
+        uint32_t getCount() const
+        {
+            return count;
+        }
+    };
+
+}
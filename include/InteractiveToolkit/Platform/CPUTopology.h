@@ -0,0 +1,352 @@
+#pragma once
+
+#include "platform_common.h"
+
+namespace Platform
+{
+
+    struct LogicalCPU
+    {
+        // OS logical processor number (the value used in the affinity masks)
+        int32_t id;
+        // index in CPUTopology::cores
+        int32_t core;
+        // index in CPUTopology::l3_domains
+        int32_t l3_domain;
+        // index in CPUTopology::numa_nodes
+        int32_t numa_node;
+        // physical package (socket) id
+        int32_t package;
+    };
+
+    /// \brief CPU topology of the current machine.
+    ///
+    /// Groups the online logical CPUs by physical core (SMT siblings),
+    /// last level cache (L3) and NUMA node.
+    ///
+    /// Linux reads /sys/devices/system/cpu and /sys/devices/system/node,
+    /// Windows uses GetLogicalProcessorInformation (current processor group)
+    /// and Apple uses sysctl (one L3 domain and one NUMA node).
+    ///
+    /// When some information is not available, each CPU is considered
+    /// a core, and all CPUs share the same L3 domain and NUMA node.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::CPUTopology *topology = Platform::CPUTopology::Instance();
+    ///
+    /// printf("physical cores: %i\n", (int)topology->cores.size());
+    ///
+    /// // pin a thread to the SMT siblings of the first core
+    /// thread.setAffinity(topology->cores[0]);
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class CPUTopology
+    {
+        // returns the index of the group with the key, creating it if needed
+        static int32_t addToGroup(std::vector<std::vector<int32_t>> *groups,
+                                  std::unordered_map<int32_t, int32_t> *key_to_group,
+                                  int32_t key, int32_t cpu)
+        {
+            auto it = key_to_group->find(key);
+            int32_t index;
+            if (it == key_to_group->end())
+            {
+                index = (int32_t)groups->size();
+                (*key_to_group)[key] = index;
+                groups->push_back(std::vector<int32_t>());
+            }
+            else
+                index = it->second;
+            (*groups)[index].push_back(cpu);
+            return index;
+        }
+
+#if defined(__linux__)
+        static bool readFileLine(const std::string &path, std::string *out)
+        {
+            FILE *file = fopen(path.c_str(), "rb");
+            if (file == nullptr)
+                return false;
+            char buffer[4096];
+            bool result = fgets(buffer, sizeof(buffer), file) != nullptr;
+            fclose(file);
+            if (!result)
+                return false;
+            *out = buffer;
+            while (out->size() > 0 && (out->back() == '\n' || out->back() == '\r' || out->back() == ' '))
+                out->pop_back();
+            return true;
+        }
+
+        static bool readFileInt(const std::string &path, int32_t *out)
+        {
+            std::string line;
+            if (!readFileLine(path, &line) || line.size() == 0)
+                return false;
+            *out = (int32_t)atoi(line.c_str());
+            return true;
+        }
+
+        // first CPU of a list file, used as group key
+        static bool readFileFirstCPU(const std::string &path, int32_t *out)
+        {
+            std::string line;
+            if (!readFileLine(path, &line))
+                return false;
+            std::vector<int32_t> list = parseCPUList(line.c_str());
+            if (list.size() == 0)
+                return false;
+            *out = list[0];
+            return true;
+        }
+
+        void detectLinux()
+        {
+            std::string online;
+            std::vector<int32_t> ids;
+            if (readFileLine("/sys/devices/system/cpu/online", &online))
+                ids = parseCPUList(online.c_str());
+            if (ids.size() == 0)
+            {
+                int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                for (int i = 0; i < count; i++)
+                    ids.push_back(i);
+            }
+
+            // cpu -> numa node
+            std::unordered_map<int32_t, int32_t> cpu_to_node;
+            std::string nodes_online;
+            if (readFileLine("/sys/devices/system/node/online", &nodes_online))
+            {
+                for (int32_t node : parseCPUList(nodes_online.c_str()))
+                {
+                    std::string cpulist;
+                    if (!readFileLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", &cpulist))
+                        continue;
+                    for (int32_t cpu : parseCPUList(cpulist.c_str()))
+                        cpu_to_node[cpu] = node;
+                }
+            }
+
+            std::unordered_map<int32_t, int32_t> core_to_group, l3_to_group, node_to_group;
+            std::unordered_map<int32_t, bool> packages;
+
+            for (int32_t id : ids)
+            {
+                std::string cpu_path = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+
+                LogicalCPU cpu;
+                cpu.id = id;
+
+                if (!readFileInt(cpu_path + "/topology/physical_package_id", &cpu.package) || cpu.package < 0)
+                    cpu.package = 0;
+                packages[cpu.package] = true;
+
+                int32_t core_key;
+                if (!readFileFirstCPU(cpu_path + "/topology/thread_siblings_list", &core_key))
+                    core_key = id;
+                cpu.core = addToGroup(&cores, &core_to_group, core_key, id);
+
+                int32_t l3_key = -1;
+                for (int i = 0; i < 16; i++)
+                {
+                    std::string index_path = cpu_path + "/cache/index" + std::to_string(i);
+                    int32_t level;
+                    if (!readFileInt(index_path + "/level", &level))
+                        break;
+                    if (level == 3 && readFileFirstCPU(index_path + "/shared_cpu_list", &l3_key))
+                        break;
+                }
+                cpu.l3_domain = addToGroup(&l3_domains, &l3_to_group, l3_key, id);
+
+                int32_t node_key = 0;
+                auto it = cpu_to_node.find(id);
+                if (it != cpu_to_node.end())
+                    node_key = it->second;
+                cpu.numa_node = addToGroup(&numa_nodes, &node_to_group, node_key, id);
+
+                cpus.push_back(cpu);
+            }
+
+            package_count = (int32_t)packages.size();
+        }
+#elif defined(_WIN32)
+        static std::vector<int32_t> maskToCPUs(ULONG_PTR mask)
+        {
+            std::vector<int32_t> result;
+            for (int32_t i = 0; i < (int32_t)(sizeof(ULONG_PTR) * 8); i++)
+                if (mask & ((ULONG_PTR)1 << i))
+                    result.push_back(i);
+            return result;
+        }
+
+        void detectWindows()
+        {
+            DWORD length = 0;
+            GetLogicalProcessorInformation(nullptr, &length);
+            std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+            if (length == 0 || !GetLogicalProcessorInformation(info.data(), &length))
+            {
+                detectFallback(querySystemCPUCount());
+                return;
+            }
+            info.resize(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+            std::unordered_map<int32_t, int32_t> cpu_core, cpu_l3, cpu_node, cpu_package;
+            int32_t core_count = 0, l3_count = 0, package_index = 0;
+            ULONG_PTR all_cpus = 0;
+            for (const auto &item : info)
+            {
+                std::vector<int32_t> list = maskToCPUs(item.ProcessorMask);
+                if (item.Relationship == RelationProcessorCore)
+                {
+                    all_cpus |= item.ProcessorMask;
+                    for (int32_t cpu : list)
+                        cpu_core[cpu] = core_count;
+                    core_count++;
+                }
+                else if (item.Relationship == RelationCache && item.Cache.Level == 3)
+                {
+                    for (int32_t cpu : list)
+                        cpu_l3[cpu] = l3_count;
+                    l3_count++;
+                }
+                else if (item.Relationship == RelationNumaNode)
+                {
+                    for (int32_t cpu : list)
+                        cpu_node[cpu] = (int32_t)item.NumaNode.NodeNumber;
+                }
+                else if (item.Relationship == RelationProcessorPackage)
+                {
+                    for (int32_t cpu : list)
+                        cpu_package[cpu] = package_index;
+                    package_index++;
+                }
+            }
+
+            std::unordered_map<int32_t, int32_t> core_to_group, l3_to_group, node_to_group;
+            for (int32_t id : maskToCPUs(all_cpus))
+            {
+                LogicalCPU cpu;
+                cpu.id = id;
+                cpu.package = cpu_package.count(id) ? cpu_package[id] : 0;
+                cpu.core = addToGroup(&cores, &core_to_group, cpu_core[id], id);
+                cpu.l3_domain = addToGroup(&l3_domains, &l3_to_group, cpu_l3.count(id) ? cpu_l3[id] : -1, id);
+                cpu.numa_node = addToGroup(&numa_nodes, &node_to_group, cpu_node.count(id) ? cpu_node[id] : 0, id);
+                cpus.push_back(cpu);
+            }
+            package_count = (package_index > 0) ? package_index : 1;
+        }
+
+        static int querySystemCPUCount()
+        {
+            SYSTEM_INFO sysinfo;
+            GetSystemInfo(&sysinfo);
+            return (int)sysinfo.dwNumberOfProcessors;
+        }
+#endif
+
+        // each CPU is a core, one L3 domain and one NUMA node
+        void detectFallback(int logical_count, int smt_per_core = 1)
+        {
+            if (logical_count <= 0)
+                logical_count = 1;
+            if (smt_per_core <= 0)
+                smt_per_core = 1;
+            std::unordered_map<int32_t, int32_t> core_to_group, l3_to_group, node_to_group;
+            for (int32_t id = 0; id < (int32_t)logical_count; id++)
+            {
+                LogicalCPU cpu;
+                cpu.id = id;
+                cpu.package = 0;
+                cpu.core = addToGroup(&cores, &core_to_group, id / smt_per_core, id);
+                cpu.l3_domain = addToGroup(&l3_domains, &l3_to_group, 0, id);
+                cpu.numa_node = addToGroup(&numa_nodes, &node_to_group, 0, id);
+                cpus.push_back(cpu);
+            }
+            package_count = 1;
+        }
+
+        CPUTopology()
+        {
+            package_count = 0;
+#if defined(__linux__)
+            detectLinux();
+#elif defined(_WIN32)
+            detectWindows();
+#elif defined(__APPLE__)
+            int logical = 0, physical = 0;
+            std::size_t len = sizeof(int);
+            sysctlbyname("hw.logicalcpu", &logical, &len, 0, 0);
+            len = sizeof(int);
+            sysctlbyname("hw.physicalcpu", &physical, &len, 0, 0);
+            int smt_per_core = (physical > 0 && logical >= physical) ? logical / physical : 1;
+            detectFallback(logical, smt_per_core);
+#endif
+            if (cpus.size() == 0)
+            {
+                cores.clear();
+                l3_domains.clear();
+                numa_nodes.clear();
+                detectFallback(1);
+            }
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        CPUTopology(const CPUTopology &v) = delete;
+        CPUTopology &operator=(const CPUTopology &v) = delete;
+
+        // online logical CPUs ordered by id
+        std::vector<LogicalCPU> cpus;
+        // logical CPU ids of each physical core (SMT siblings)
+        std::vector<std::vector<int32_t>> cores;
+        // logical CPU ids sharing the same last level cache
+        std::vector<std::vector<int32_t>> l3_domains;
+        // logical CPU ids of each NUMA node
+        std::vector<std::vector<int32_t>> numa_nodes;
+        int32_t package_count;
+
+        /// \brief Parse a Linux CPU list string
+        ///
+        /// Example: "0-3,8,10-11" returns {0,1,2,3,8,10,11}
+        ///
+        static std::vector<int32_t> parseCPUList(const char *str)
+        {
+            std::vector<int32_t> result;
+            const char *ptr = str;
+            while (*ptr != 0)
+            {
+                while (*ptr == ',' || *ptr == ' ')
+                    ptr++;
+                if (*ptr < '0' || *ptr > '9')
+                    break;
+                char *end;
+                int32_t begin = (int32_t)strtol(ptr, &end, 10);
+                int32_t last = begin;
+                ptr = end;
+                if (*ptr == '-')
+                {
+                    ptr++;
+                    last = (int32_t)strtol(ptr, &end, 10);
+                    ptr = end;
+                }
+                for (int32_t i = begin; i <= last; i++)
+                    result.push_back(i);
+            }
+            return result;
+        }
+
+        static CPUTopology *Instance()
+        {
+            static CPUTopology topology;
+            return &topology;
+        }
+    };
+
+}
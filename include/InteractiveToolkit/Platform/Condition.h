@@ -2,176 +2,149 @@
 
 //#include "platform_common.h"
 #include "../common.h"
-#include "AutoLock.h"
-#include "Semaphore.h"
+#include "Thread.h"
 #include "Mutex.h"
-#include "Core/ObjectPool.h"
+#include "Core/Futex.h"
 
 namespace Platform
 {
 
+    /// \brief Condition variable built on a futex sequence counter.
+    ///
+    /// The waiter reads the sequence while holding the mutex, unlocks it and parks
+    /// until the sequence changes. A notify increments the sequence and wakes one
+    /// (or all) parked threads. There is no waiter list and no allocation per wait,
+    /// and the wake syscall is skipped when nobody is waiting.
+    ///
+    /// Spurious wake ups can happen: always check the predicate in a loop.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::Mutex mutex;
+    /// Platform::Condition condition;
+    /// bool ready = false;
+    ///
+    /// // consumer
+    /// mutex.lock();
+    /// bool signaled = false;
+    /// while (!ready && !signaled)
+    ///     condition.wait(&mutex, &signaled);
+    /// mutex.unlock();
+    ///
+    /// // producer
+    /// mutex.lock();
+    /// ready = true;
+    /// mutex.unlock();
+    /// condition.notify_one();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
     class Condition
     {
-        Mutex internal_lock;
-        std::vector<Semaphore *> notifiable;
-        std::vector<Semaphore *> released;
-        Mutex *mtx;
-
-        Platform::ObjectPool<Semaphore> local_semaphores;
-
-    public:
-        Condition()
+        // value = (sequence << 1) | waiters bit
+        //
+        // the waiters bit is in the same word of the sequence: a notify is one
+        // atomic operation and does not read the condition after it
+        // (a woken thread may destroy it)
+        std::atomic<uint32_t> sequence;
+        // only changed by the waiting threads
+        std::atomic<uint32_t> waiters;
+
+        static const uint32_t WaitersBit = 1;
+        static const uint32_t SequenceOne = 2;
+
+        bool waitSequence(Mutex *mutex, uint32_t timeout_ms, bool *_signaled)
         {
-            mtx = nullptr;
-        }
+            // read while the mutex is locked:
+            // any notify after the unlock changes the sequence, and the futex does not park
+            uint32_t seq = sequence.load(std::memory_order_acquire) & ~WaitersBit;
+            waiters.fetch_add(1);
+            uint32_t value = sequence.fetch_or(WaitersBit);
 
-        void wait(Mutex *mutex, bool *_signaled = nullptr)
-        {
-            //Semaphore *this_semaphore = new Semaphore(0);
+            mutex->unlock();
 
-            Semaphore *this_semaphore = local_semaphores.create(true);
+            FutexWaitResult result = FutexWaitResult::Woken;
+            if ((value & ~WaitersBit) == seq)
+                result = Futex::waitInterruptible(&sequence, seq | WaitersBit, timeout_ms);
 
+            // the last waiter clears the bit
+            uint32_t waiters_guess = waiters.load();
+            if (waiters_guess == 1)
+                sequence.fetch_and(~WaitersBit);
+            uint32_t waiters_final = waiters.fetch_sub(1);
+            if (waiters_final > 1 && waiters_guess == 1)
             {
-                AutoLock lk(&internal_lock);
-                mtx = mutex;
-                notifiable.push_back(this_semaphore);
+                // a new waiter might have parked before the bit was cleared
+                sequence.fetch_or(WaitersBit);
+                Futex::wakeAll(&sequence);
             }
 
-            mutex->unlock();
-
-            bool signaled = !this_semaphore->blockingAcquire();
+            // this thread may have consumed a notify_one: pass it to the next waiter
+            if (result == FutexWaitResult::Interrupted && (sequence.load() & ~WaitersBit) != seq)
+                Futex::wakeOne(&sequence);
 
             mutex->lock();
 
-            {
-                AutoLock lk(&internal_lock);
-
-                auto it = std::find(released.begin(), released.end(), this_semaphore);
-                if (it != released.end())
-                {
-                    //the semaphore was released before the thread interrupt/signaling...
-                    released.erase(it);
-                    
-                    //force blocking aquire to make semaphore state to 0
-                    if (signaled)
-                        this_semaphore->blockingAcquire(true);
-
-                    signaled = false;
-                }
-
-                if (_signaled != nullptr)
-                    *_signaled = signaled;
-
-                if (signaled)
-                {
-                    auto it = std::find(notifiable.begin(), notifiable.end(), this_semaphore);
-                    if (it != notifiable.end())
-                        notifiable.erase(it);
-
-                    if (notifiable.size() == 0)
-                        mtx = nullptr;
-                }
-            }
+            if (_signaled != nullptr)
+                *_signaled = result == FutexWaitResult::Interrupted;
 
-            //delete this_semaphore;
-            local_semaphores.release(this_semaphore);
+            return result == FutexWaitResult::Woken;
         }
 
-        void wait_for(Mutex *mutex, uint32_t timeout_ms, bool *_signaled = nullptr)
-        {
-
-            Semaphore *this_semaphore = new Semaphore(0);
-
-            {
-                AutoLock lk(&internal_lock);
-                mtx = mutex;
-                notifiable.push_back(this_semaphore);
-            }
-
-            mutex->unlock();
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        Condition(const Condition &v) = delete;
+        Condition &operator=(const Condition &v) = delete;
 
-            bool aquired = this_semaphore->tryToAcquire(timeout_ms);
-            bool signaled = false;
-            if (!aquired)
-                signaled = this_semaphore->isSignaled();
+        Condition()
+        {
+            sequence = 0;
+            waiters = 0;
+        }
 
-            mutex->lock();
+        /// \brief Unlock the mutex, wait a notification and lock the mutex again
+        ///
+        /// \param mutex the mutex locked by the current thread
+        /// \param _signaled if not null, will be set to true if the current thread was interrupted
+        ///
+        void wait(Mutex *mutex, bool *_signaled = nullptr)
+        {
+            waitSequence(mutex, UINT32_MAX, _signaled);
+        }
 
-            {
-                AutoLock lk(&internal_lock);
-
-                auto it = std::find(released.begin(), released.end(), this_semaphore);
-                if (it != released.end())
-                {
-                    //the semaphore was released before the thread interrupt/signaling...
-                    released.erase(it);
-                    signaled = false;
-                }
-
-                if (_signaled != nullptr)
-                    *_signaled = signaled;
-
-                if (signaled || !aquired)
-                {
-                    auto it = std::find(notifiable.begin(), notifiable.end(), this_semaphore);
-                    if (it != notifiable.end())
-                        notifiable.erase(it);
-
-                    if (notifiable.size() == 0)
-                        mtx = nullptr;
-                }
-            }
+        /// \brief Unlock the mutex, wait a notification (or the timeout) and lock the mutex again
+        ///
+        /// \param mutex the mutex locked by the current thread
+        /// \param timeout_ms max time to wait
+        /// \param _signaled if not null, will be set to true if the current thread was interrupted
+        /// \return false on timeout or interruption
+        ///
+        bool wait_for(Mutex *mutex, uint32_t timeout_ms, bool *_signaled = nullptr)
+        {
+            return waitSequence(mutex, timeout_ms, _signaled);
+        }
 
-            delete this_semaphore;
+        // wake exactly one parked waiter
+        void notify_one()
+        {
+            std::atomic<uint32_t> *address = &sequence;
+            if ((address->fetch_add(SequenceOne) & WaitersBit) != 0)
+                Futex::wakeOne(address);
         }
 
         void notify()
         {
-            AutoLock lk(&internal_lock);
-
-            if (mtx == nullptr)
-                return;
-
-            AutoLock lock(mtx);
-
-            if (notifiable.size() == 0)
-            {
-                mtx = nullptr;
-                return;
-            }
-
-            auto sem_to_notify = *notifiable.begin();
-            notifiable.erase(notifiable.begin());
-            released.push_back(sem_to_notify);
-            sem_to_notify->release();
-
-            if (notifiable.size() == 0)
-                mtx = nullptr;
+            notify_one();
         }
 
         void notify_all()
         {
-            AutoLock lk(&internal_lock);
-
-            if (mtx == nullptr)
-                return;
-
-            AutoLock lock(mtx);
-
-            if (notifiable.size() == 0)
-            {
-                mtx = nullptr;
-                return;
-            }
-
-            for (auto sem_to_notify : notifiable)
-            {
-                sem_to_notify->release();
-                released.push_back(sem_to_notify);
-            }
-            notifiable.clear();
-
-            mtx = nullptr;
+            std::atomic<uint32_t> *address = &sequence;
+            if ((address->fetch_add(SequenceOne) & WaitersBit) != 0)
+                Futex::wakeAll(address);
         }
     };
 
@@ -0,0 +1,368 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+#include "../Mutex.h"
+#include "../AutoLock.h"
+#include "../../EventCore/Callback.h"
+#include "../../ITKCommon/Memory.h"
+
+#include "./EpochManager.h"
+
+namespace Platform
+{
+
+    /// \brief Sharded hash map with lock-free reads.
+    ///
+    /// The keys are distributed over independent shards (power of two). Each shard has
+    /// its own write mutex and a chained bucket table.
+    ///
+    /// Readers do not lock: they traverse the chains inside an EpochGuard.
+    /// The nodes are never modified after they are linked. An assignment replaces
+    /// the node, and an erase unlinks it. When a shard grows, a new table is built and
+    /// published. The old nodes and tables are freed by the EpochManager.
+    ///
+    /// find copies the value, so it is still valid after the entry is replaced.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::ConcurrentHashMap<std::string, sockaddr_in> address_cache;
+    ///
+    /// // any thread
+    /// sockaddr_in addr;
+    /// if (!address_cache.find(host, &addr)) {
+    ///     addr = resolve(host);
+    ///     address_cache.insertOrAssign(host, addr);
+    /// }
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+    class ConcurrentHashMap
+    {
+        static const size_t MIN_BUCKETS = 16;
+
+        struct Node
+        {
+            size_t hash;
+            K key;
+            V value;
+            std::atomic<Node *> next;
+
+            Node(size_t hash, const K &key, const V &value) : hash(hash), key(key), value(value)
+            {
+                next = nullptr;
+            }
+        };
+
+        struct Table
+        {
+            size_t bucket_count;
+            std::atomic<Node *> *buckets;
+
+            Table(size_t bucket_count)
+            {
+                this->bucket_count = bucket_count;
+                buckets = new std::atomic<Node *>[bucket_count];
+                for (size_t i = 0; i < bucket_count; i++)
+                    buckets[i].store(nullptr, std::memory_order_relaxed);
+            }
+
+            // deletes the linked nodes too
+            ~Table()
+            {
+                for (size_t i = 0; i < bucket_count; i++)
+                {
+                    Node *node = buckets[i].load(std::memory_order_relaxed);
+                    while (node != nullptr)
+                    {
+                        Node *next = node->next.load(std::memory_order_relaxed);
+                        delete node;
+                        node = next;
+                    }
+                }
+                delete[] buckets;
+            }
+
+            std::atomic<Node *> &bucketFor(size_t hash)
+            {
+                return buckets[hash & (bucket_count - 1)];
+            }
+        };
+
+        struct alignas(ITK_CACHE_LINE_SIZE) Shard
+        {
+            std::atomic<Table *> table;
+            // the fields below are protected by the mutex
+            Platform::Mutex mutex;
+            size_t count;
+        };
+
+        Shard *shards;
+        uint32_t shard_count;
+        uint32_t shard_shift;
+        Hash hasher;
+        KeyEqual key_equal;
+
+        // std::hash is the identity for integers: mix the bits before using them
+        size_t hashOf(const K &key) const
+        {
+            uint64_t h = (uint64_t)hasher(key);
+            h ^= h >> 33;
+            h *= UINT64_C(0xff51afd7ed558ccd);
+            h ^= h >> 33;
+            h *= UINT64_C(0xc4ceb9fe1a85ec53);
+            h ^= h >> 33;
+            return (size_t)h;
+        }
+
+        // the high bits select the shard, the low bits the bucket
+        Shard &shardFor(size_t hash) const
+        {
+            if (shard_count == 1)
+                return shards[0];
+            return shards[hash >> shard_shift];
+        }
+
+        Node *findNode(Table *table, size_t hash, const K &key) const
+        {
+            Node *node = table->bucketFor(hash).load(std::memory_order_acquire);
+            while (node != nullptr)
+            {
+                if (node->hash == hash && key_equal(node->key, key))
+                    return node;
+                node = node->next.load(std::memory_order_acquire);
+            }
+            return nullptr;
+        }
+
+        static void deleteNode(void *ptr)
+        {
+            delete (Node *)ptr;
+        }
+
+        static void deleteTable(void *ptr)
+        {
+            delete (Table *)ptr;
+        }
+
+        // shard mutex locked
+        void growIfNeeded(Shard &shard)
+        {
+            Table *table = shard.table.load(std::memory_order_relaxed);
+            if (shard.count <= table->bucket_count)
+                return;
+
+            // copy the nodes: the readers can still be traversing the old chains
+            Table *new_table = new Table(table->bucket_count << 1);
+            for (size_t i = 0; i < table->bucket_count; i++)
+            {
+                Node *node = table->buckets[i].load(std::memory_order_relaxed);
+                while (node != nullptr)
+                {
+                    Node *copy = new Node(node->hash, node->key, node->value);
+                    std::atomic<Node *> &bucket = new_table->bucketFor(node->hash);
+                    copy->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    bucket.store(copy, std::memory_order_relaxed);
+                    node = node->next.load(std::memory_order_relaxed);
+                }
+            }
+            shard.table.store(new_table, std::memory_order_release);
+            EpochManager::Instance()->retire(table, &ConcurrentHashMap::deleteTable);
+        }
+
+        // returns false if the key exists and assign is false
+        bool put(const K &key, const V &value, bool assign)
+        {
+            size_t hash = hashOf(key);
+            Shard &shard = shardFor(hash);
+            Platform::AutoLock autoLock(&shard.mutex);
+
+            Table *table = shard.table.load(std::memory_order_relaxed);
+            std::atomic<Node *> *link = &table->bucketFor(hash);
+            Node *node = link->load(std::memory_order_relaxed);
+            while (node != nullptr)
+            {
+                if (node->hash == hash && key_equal(node->key, key))
+                {
+                    if (!assign)
+                        return false;
+                    Node *replacement = new Node(hash, key, value);
+                    replacement->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    link->store(replacement, std::memory_order_release);
+                    EpochManager::Instance()->retire(node, &ConcurrentHashMap::deleteNode);
+                    return true;
+                }
+                link = &node->next;
+                node = link->load(std::memory_order_relaxed);
+            }
+
+            Node *new_node = new Node(hash, key, value);
+            std::atomic<Node *> &bucket = table->bucketFor(hash);
+            new_node->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            bucket.store(new_node, std::memory_order_release);
+            shard.count++;
+            growIfNeeded(shard);
+            return true;
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        ConcurrentHashMap(const ConcurrentHashMap &v) = delete;
+        ConcurrentHashMap &operator=(const ConcurrentHashMap &v) = delete;
+
+        /// \brief Construct the map
+        ///
+        /// \param shard_count number of independent write locks, rounded up to a power of two
+        ///
+        ConcurrentHashMap(uint32_t shard_count = 64)
+        {
+            this->shard_count = 1;
+            uint32_t bits = 0;
+            while (this->shard_count < shard_count)
+            {
+                this->shard_count <<= 1;
+                bits++;
+            }
+            shard_shift = (uint32_t)(sizeof(size_t) * 8) - bits;
+            // cache aligned (the C++11 new does not respect alignas)
+            shards = (Shard *)ITKCommon::Memory::malloc(sizeof(Shard) * this->shard_count, ITK_CACHE_LINE_SIZE);
+            for (uint32_t i = 0; i < this->shard_count; i++)
+            {
+                new (&shards[i]) Shard();
+                shards[i].table = new Table(MIN_BUCKETS);
+                shards[i].count = 0;
+            }
+        }
+
+        // there must be no reader or writer running
+        ~ConcurrentHashMap()
+        {
+            for (uint32_t i = 0; i < shard_count; i++)
+            {
+                delete shards[i].table.load();
+                shards[i].~Shard();
+            }
+            ITKCommon::Memory::free(shards);
+        }
+
+        /// \brief Lock-free lookup
+        ///
+        /// \return true if the key was found and the value copied to out
+        ///
+        bool find(const K &key, V *out) const
+        {
+            size_t hash = hashOf(key);
+            EpochGuard guard;
+            Table *table = shardFor(hash).table.load(std::memory_order_acquire);
+            Node *node = findNode(table, hash, key);
+            if (node == nullptr)
+                return false;
+            *out = node->value;
+            return true;
+        }
+
+        bool contains(const K &key) const
+        {
+            size_t hash = hashOf(key);
+            EpochGuard guard;
+            Table *table = shardFor(hash).table.load(std::memory_order_acquire);
+            return findNode(table, hash, key) != nullptr;
+        }
+
+        V getOrDefault(const K &key, const V &default_value = V()) const
+        {
+            V result;
+            if (find(key, &result))
+                return result;
+            return default_value;
+        }
+
+        // returns false if the key already exists (the value is not changed)
+        bool insert(const K &key, const V &value)
+        {
+            return put(key, value, false);
+        }
+
+        void insertOrAssign(const K &key, const V &value)
+        {
+            put(key, value, true);
+        }
+
+        bool erase(const K &key)
+        {
+            size_t hash = hashOf(key);
+            Shard &shard = shardFor(hash);
+            Platform::AutoLock autoLock(&shard.mutex);
+
+            Table *table = shard.table.load(std::memory_order_relaxed);
+            std::atomic<Node *> *link = &table->bucketFor(hash);
+            Node *node = link->load(std::memory_order_relaxed);
+            while (node != nullptr)
+            {
+                if (node->hash == hash && key_equal(node->key, key))
+                {
+                    // the readers in the node keep a valid next pointer
+                    link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                    shard.count--;
+                    EpochManager::Instance()->retire(node, &ConcurrentHashMap::deleteNode);
+                    return true;
+                }
+                link = &node->next;
+                node = link->load(std::memory_order_relaxed);
+            }
+            return false;
+        }
+
+        void clear()
+        {
+            for (uint32_t i = 0; i < shard_count; i++)
+            {
+                Shard &shard = shards[i];
+                Platform::AutoLock autoLock(&shard.mutex);
+                Table *table = shard.table.load(std::memory_order_relaxed);
+                shard.table.store(new Table(MIN_BUCKETS), std::memory_order_release);
+                shard.count = 0;
+                EpochManager::Instance()->retire(table, &ConcurrentHashMap::deleteTable);
+            }
+        }
+
+        // sum of the shard counts (not a snapshot while writers are running)
+        size_t size()
+        {
+            size_t result = 0;
+            for (uint32_t i = 0; i < shard_count; i++)
+            {
+                Platform::AutoLock autoLock(&shards[i].mutex);
+                result += shards[i].count;
+            }
+            return result;
+        }
+
+        /// \brief Visit all entries without locking.
+        ///
+        /// Entries inserted or erased during the visit may or may not be visited.
+        ///
+        void forEach(const EventCore::Callback<void(const K &, const V &)> &callback) const
+        {
+            EpochGuard guard;
+            for (uint32_t i = 0; i < shard_count; i++)
+            {
+                Table *table = shards[i].table.load(std::memory_order_acquire);
+                for (size_t b = 0; b < table->bucket_count; b++)
+                {
+                    Node *node = table->buckets[b].load(std::memory_order_acquire);
+                    while (node != nullptr)
+                    {
+                        callback(node->key, node->value);
+                        node = node->next.load(std::memory_order_acquire);
+                    }
+                }
+            }
+        }
+    };
+
+}
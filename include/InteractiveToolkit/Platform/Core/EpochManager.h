@@ -0,0 +1,339 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+#include "../Mutex.h"
+#include "../AutoLock.h"
+#include "../Sleep.h"
+
+#include "../../ITKCommon/ITKAbort.h"
+#include "../../ITKCommon/Memory.h"
+
+// number of retired objects in a thread before it tries to advance the epoch and free memory
+#ifndef ITK_EPOCH_COLLECT_THRESHOLD
+#define ITK_EPOCH_COLLECT_THRESHOLD 64
+#endif
+
+namespace Platform
+{
+
+    /// \brief Epoch-based memory reclamation for lock-free structures.
+    ///
+    /// Readers enter a critical section (EpochGuard) before they load the shared pointers,
+    /// and leave it when they stop using them. Writers replace a node and retire
+    /// the old one: it is freed only after all threads that could see it left their critical sections.
+    ///
+    /// The global epoch advances when every thread inside a critical section already
+    /// observed the current epoch. An object retired in epoch E is freed when the
+    /// global epoch reaches E + 2. Threads outside a critical section are quiescent and
+    /// never block the reclamation.
+    ///
+    /// Each thread has a record, created in its first use. When a Platform::Thread finishes
+    /// (ThreadDataSet::unregisterThread), or any other thread exits, its pending objects
+    /// move to an orphan list freed by the other threads.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// std::atomic<RoutingTable *> table;
+    ///
+    /// // reader
+    /// {
+    ///     Platform::EpochGuard guard;
+    ///     RoutingTable *current = table.load(std::memory_order_acquire);
+    ///     current->lookup(address);
+    /// }
+    ///
+    /// // writer
+    /// RoutingTable *old_table = table.exchange(new_table);
+    /// Platform::EpochManager::Instance()->retire(old_table);
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class EpochManager
+    {
+        struct Retired
+        {
+            void *ptr;
+            void (*deleter)(void *);
+            uint64_t epoch;
+        };
+
+        struct alignas(ITK_CACHE_LINE_SIZE) ThreadRecord
+        {
+            // (epoch << 1) | 1 inside a critical section, 0 when quiescent
+            std::atomic<uint64_t> local_epoch;
+            std::atomic<bool> in_use;
+            ThreadRecord *next;
+
+            // accessed only by the owner thread
+            uint32_t nesting;
+            std::vector<Retired> retired;
+
+            ThreadRecord()
+            {
+                local_epoch = 0;
+                in_use = true;
+                next = nullptr;
+                nesting = 0;
+            }
+        };
+
+        // releases the record when the OS thread exits
+        struct ThreadRecordHolder
+        {
+            ThreadRecord *record;
+
+            ThreadRecordHolder()
+            {
+                record = nullptr;
+            }
+
+            ~ThreadRecordHolder()
+            {
+                if (record != nullptr)
+                    EpochManager::Instance()->threadExit();
+            }
+        };
+
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint64_t> global_epoch;
+        // append only list, the records are reused by new threads
+        std::atomic<ThreadRecord *> records;
+
+        Platform::Mutex orphan_mutex;
+        std::vector<Retired> orphans;
+        std::atomic<uint32_t> orphan_count;
+
+        static ThreadRecordHolder &threadRecordHolder()
+        {
+            static thread_local ThreadRecordHolder holder;
+            return holder;
+        }
+
+        ThreadRecord *currentRecord()
+        {
+            ThreadRecordHolder &holder = threadRecordHolder();
+            if (holder.record != nullptr)
+                return holder.record;
+
+            // reuse the record of an exited thread
+            for (ThreadRecord *record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+            {
+                bool expected = false;
+                if (!record->in_use.load(std::memory_order_relaxed) &&
+                    record->in_use.compare_exchange_strong(expected, true))
+                {
+                    holder.record = record;
+                    return record;
+                }
+            }
+
+            // cache aligned (the C++11 new does not respect alignas)
+            ThreadRecord *record = new (ITKCommon::Memory::malloc(sizeof(ThreadRecord), ITK_CACHE_LINE_SIZE)) ThreadRecord();
+            ThreadRecord *head = records.load(std::memory_order_relaxed);
+            do
+            {
+                record->next = head;
+            } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+            holder.record = record;
+            return record;
+        }
+
+        // advances the global epoch if all threads inside a critical section observed it
+        bool tryAdvance()
+        {
+            uint64_t epoch = global_epoch.load();
+            for (ThreadRecord *record = records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+            {
+                uint64_t local = record->local_epoch.load();
+                if ((local & 1) != 0 && (local >> 1) != epoch)
+                    return false;
+            }
+            return global_epoch.compare_exchange_strong(epoch, epoch + 1);
+        }
+
+        static void freeExpired(std::vector<Retired> *list, uint64_t epoch)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < list->size(); i++)
+            {
+                Retired &item = (*list)[i];
+                if (item.epoch + 2 <= epoch)
+                    item.deleter(item.ptr);
+                else
+                    (*list)[count++] = item;
+            }
+            list->resize(count);
+        }
+
+        void collect(ThreadRecord *record)
+        {
+            tryAdvance();
+            uint64_t epoch = global_epoch.load();
+            freeExpired(&record->retired, epoch);
+
+            if (orphan_count.load(std::memory_order_relaxed) > 0)
+            {
+                Platform::AutoLock autoLock(&orphan_mutex);
+                freeExpired(&orphans, epoch);
+                orphan_count.store((uint32_t)orphans.size(), std::memory_order_relaxed);
+            }
+        }
+
+        EpochManager()
+        {
+            global_epoch = 1;
+            records = nullptr;
+            orphan_count = 0;
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        EpochManager(const EpochManager &v) = delete;
+        EpochManager &operator=(const EpochManager &v) = delete;
+
+        ~EpochManager()
+        {
+            // process exit: no reader is running
+            ThreadRecord *record = records.load();
+            while (record != nullptr)
+            {
+                for (auto &item : record->retired)
+                    item.deleter(item.ptr);
+                ThreadRecord *next = record->next;
+                record->~ThreadRecord();
+                ITKCommon::Memory::free(record);
+                record = next;
+            }
+            records = nullptr;
+            for (auto &item : orphans)
+                item.deleter(item.ptr);
+            orphans.clear();
+        }
+
+        /// \brief Begin a read critical section. Can be nested.
+        ///
+        void enter()
+        {
+            ThreadRecord *record = currentRecord();
+            if (record->nesting++ > 0)
+                return;
+            record->local_epoch.store((global_epoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+            // the epoch must be visible before the reads of the shared pointers
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        /// \brief End a read critical section.
+        ///
+        void exit()
+        {
+            ThreadRecord *record = currentRecord();
+            if (--record->nesting > 0)
+                return;
+            record->local_epoch.store(0, std::memory_order_release);
+        }
+
+        bool isInsideCriticalSection()
+        {
+            return currentRecord()->nesting > 0;
+        }
+
+        /// \brief Free the object after all current readers leave their critical sections.
+        ///
+        void retire(void *ptr, void (*deleter)(void *))
+        {
+            ThreadRecord *record = currentRecord();
+            Retired item;
+            item.ptr = ptr;
+            item.deleter = deleter;
+            item.epoch = global_epoch.load();
+            record->retired.push_back(item);
+            if (record->retired.size() >= ITK_EPOCH_COLLECT_THRESHOLD)
+                collect(record);
+        }
+
+        template <typename T>
+        void retire(T *ptr)
+        {
+            retire(ptr, [](void *p)
+                   { delete (T *)p; });
+        }
+
+        /// \brief Block until the objects retired by the current thread are freed.
+        ///
+        /// Must be called outside a critical section.
+        ///
+        void synchronize()
+        {
+            ThreadRecord *record = currentRecord();
+            ITK_ABORT(record->nesting > 0, "EpochManager::synchronize called inside a critical section.\n");
+            while (record->retired.size() > 0)
+            {
+                collect(record);
+                if (record->retired.size() > 0)
+                    Platform::Sleep::yield();
+            }
+        }
+
+        /// \brief Release the record of the calling thread.
+        ///
+        /// Called by ThreadDataSet::unregisterThread and at the OS thread exit.
+        ///
+        void threadExit()
+        {
+            ThreadRecordHolder &holder = threadRecordHolder();
+            ThreadRecord *record = holder.record;
+            if (record == nullptr)
+                return;
+            holder.record = nullptr;
+
+            collect(record);
+            if (record->retired.size() > 0)
+            {
+                Platform::AutoLock autoLock(&orphan_mutex);
+                orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+                orphan_count.store((uint32_t)orphans.size(), std::memory_order_relaxed);
+            }
+            record->retired.clear();
+            record->nesting = 0;
+            record->local_epoch.store(0, std::memory_order_release);
+            record->in_use.store(false, std::memory_order_release);
+        }
+
+        uint64_t currentEpoch() const
+        {
+            return global_epoch.load();
+        }
+
+        static EpochManager *Instance()
+        {
+            static EpochManager manager;
+            return &manager;
+        }
+    };
+
+    /// \brief Scoped EBR critical section.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class EpochGuard
+    {
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        EpochGuard(const EpochGuard &v) = delete;
+        EpochGuard &operator=(const EpochGuard &v) = delete;
+
+        EpochGuard()
+        {
+            EpochManager::Instance()->enter();
+        }
+
+        ~EpochGuard()
+        {
+            EpochManager::Instance()->exit();
+        }
+    };
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "../platform_common.h"
+#include "../Sleep.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#endif
+
+// maximum time a parked thread waits before checking the interrupt flag
+// on platforms where the interrupt cannot wake the wait address (windows, apple)
+#ifndef ITK_FUTEX_INTERRUPT_CHECK_MS
+#define ITK_FUTEX_INTERRUPT_CHECK_MS 50
+#endif
+
+// polling interval of the process shared waits on platforms without
+// a cross-process wait address (windows, apple)
+#ifndef ITK_FUTEX_SHARED_POLL_MS
+#define ITK_FUTEX_SHARED_POLL_MS 1
+#endif
+
+namespace Platform
+{
+
+    enum class FutexWaitResult : uint8_t
+    {
+        // woken up, value changed or spurious wake up: the caller must check its condition again
+        Woken,
+        Timeout,
+        Interrupted
+    };
+
+    /// \brief Wait/wake on a 32 bit atomic word.
+    ///
+    /// Linux uses futex(2), Windows uses WaitOnAddress, and the other platforms
+    /// use a hashed table of condition variables.
+    ///
+    /// It is the building block of the user space primitives: the fast path is done
+    /// with atomics, and the thread only parks in the kernel when it must wait.
+    ///
+    /// With process_shared the word can be in shared memory (IPC). Only linux can park
+    /// on a shared address, the other platforms poll every ITK_FUTEX_SHARED_POLL_MS.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class Futex
+    {
+#if !defined(__linux__) && !defined(_WIN32)
+        struct Bucket
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        static Bucket *bucketFor(const void *address)
+        {
+            static Bucket buckets[64];
+            uintptr_t v = (uintptr_t)address;
+            return &buckets[(v >> 4) % 64];
+        }
+#endif
+
+    public:
+        /// \brief Park the current thread while *address == expected.
+        ///
+        /// It is not interruptible. Use waitInterruptible to respect Thread::interrupt().
+        ///
+        /// \param timeout_ms UINT32_MAX waits forever
+        /// \param process_shared the address is in memory shared with other processes
+        ///
+        static FutexWaitResult waitRaw(std::atomic<uint32_t> *address, uint32_t expected, uint32_t timeout_ms = UINT32_MAX, bool process_shared = false)
+        {
+#if !defined(__linux__)
+            if (process_shared)
+            {
+                // the wait address cannot be shared with other processes: poll
+                if (address->load() != expected)
+                    return FutexWaitResult::Woken;
+                uint32_t slice = (timeout_ms < ITK_FUTEX_SHARED_POLL_MS) ? timeout_ms : ITK_FUTEX_SHARED_POLL_MS;
+                Sleep::millis((int)slice);
+                return (slice == timeout_ms) ? FutexWaitResult::Timeout : FutexWaitResult::Woken;
+            }
+#endif
+#if defined(__linux__)
+            struct timespec ts;
+            struct timespec *ts_ptr = nullptr;
+            if (timeout_ms != UINT32_MAX)
+            {
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = ((long)timeout_ms % 1000L) * 1000000L;
+                ts_ptr = &ts;
+            }
+            long rc = syscall(SYS_futex, (uint32_t *)address, (process_shared) ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected, ts_ptr, nullptr, 0);
+            if (rc == -1 && errno == ETIMEDOUT)
+                return FutexWaitResult::Timeout;
+            return FutexWaitResult::Woken;
+#elif defined(_WIN32)
+            DWORD dwTimeout = (timeout_ms == UINT32_MAX) ? INFINITE : (DWORD)timeout_ms;
+            if (!WaitOnAddress((volatile VOID *)address, &expected, sizeof(uint32_t), dwTimeout) &&
+                GetLastError() == ERROR_TIMEOUT)
+                return FutexWaitResult::Timeout;
+            return FutexWaitResult::Woken;
+#else
+            Bucket *bucket = bucketFor(address);
+            std::unique_lock<std::mutex> lock(bucket->mutex);
+            if (address->load() != expected)
+                return FutexWaitResult::Woken;
+            if (timeout_ms == UINT32_MAX)
+            {
+                bucket->cv.wait(lock);
+                return FutexWaitResult::Woken;
+            }
+            if (bucket->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
+                return FutexWaitResult::Timeout;
+            return FutexWaitResult::Woken;
+#endif
+        }
+
+        static void wakeOne(std::atomic<uint32_t> *address, bool process_shared = false)
+        {
+#if defined(__linux__)
+            syscall(SYS_futex, (uint32_t *)address, (process_shared) ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+            // the shared waiters poll
+            if (process_shared)
+                return;
+            WakeByAddressSingle((PVOID)address);
+#else
+            if (process_shared)
+                return;
+            // the bucket is shared with other addresses
+            Bucket *bucket = bucketFor(address);
+            std::lock_guard<std::mutex> lock(bucket->mutex);
+            bucket->cv.notify_all();
+#endif
+        }
+
+        static void wakeAll(std::atomic<uint32_t> *address, bool process_shared = false)
+        {
+#if defined(__linux__)
+            syscall(SYS_futex, (uint32_t *)address, (process_shared) ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+            if (process_shared)
+                return;
+            WakeByAddressAll((PVOID)address);
+#else
+            if (process_shared)
+                return;
+            Bucket *bucket = bucketFor(address);
+            std::lock_guard<std::mutex> lock(bucket->mutex);
+            bucket->cv.notify_all();
+#endif
+        }
+
+        /// \brief Park the current thread while *address == expected, respecting Thread::interrupt().
+        ///
+        /// \param timeout_ms UINT32_MAX waits forever
+        /// \param ignore_signal if true, the interrupt flag is ignored
+        /// \param process_shared the address is in memory shared with other processes
+        ///
+        static FutexWaitResult waitInterruptible(std::atomic<uint32_t> *address, uint32_t expected, uint32_t timeout_ms = UINT32_MAX, bool ignore_signal = false, bool process_shared = false);
+
+        /// \brief Spin while *address == expected, then park with waitInterruptible.
+        ///
+        static FutexWaitResult spinThenWait(std::atomic<uint32_t> *address, uint32_t expected, uint32_t spin_count, uint32_t timeout_ms = UINT32_MAX, bool ignore_signal = false)
+        {
+            for (uint32_t i = 0; i < spin_count; i++)
+            {
+                if (address->load(std::memory_order_acquire) != expected)
+                    return FutexWaitResult::Woken;
+                Sleep::cpuRelax();
+            }
+            return waitInterruptible(address, expected, timeout_ms, ignore_signal);
+        }
+    };
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Futex.h"
+#include "../Thread.h"
+
+namespace Platform
+{
+
+    inline FutexWaitResult Futex::waitInterruptible(std::atomic<uint32_t> *address, uint32_t expected, uint32_t timeout_ms, bool ignore_signal, bool process_shared)
+    {
+        if (ignore_signal)
+            return waitRaw(address, expected, timeout_ms, process_shared);
+
+#if defined(__linux__)
+        // same protocol as the semaphores: Thread::interrupt() signals the
+        // thread with SIGUSR1 while it has opened waits, and futex returns EINTR
+        Platform::Thread *currentThread = Platform::Thread::getCurrentThread();
+
+        currentThread->semaphoreLock();
+        if (Platform::Thread::isCurrentThreadInterrupted())
+        {
+            currentThread->semaphoreUnLock();
+            return FutexWaitResult::Interrupted;
+        }
+        currentThread->semaphoreWaitBegin(nullptr);
+        currentThread->semaphoreUnLock();
+
+        FutexWaitResult result = waitRaw(address, expected, timeout_ms, process_shared);
+
+        currentThread->semaphoreWaitDone(nullptr);
+
+        if (result == FutexWaitResult::Woken && Platform::Thread::isCurrentThreadInterrupted())
+            return FutexWaitResult::Interrupted;
+        return result;
+#else
+        // the interrupt cannot wake the address: wait in slices and check the flag
+        uint32_t remaining = timeout_ms;
+        while (true)
+        {
+            if (Platform::Thread::isCurrentThreadInterrupted())
+                return FutexWaitResult::Interrupted;
+
+            uint32_t slice = ITK_FUTEX_INTERRUPT_CHECK_MS;
+            if (remaining != UINT32_MAX && remaining < slice)
+                slice = remaining;
+
+            if (waitRaw(address, expected, slice, process_shared) == FutexWaitResult::Woken)
+            {
+                if (Platform::Thread::isCurrentThreadInterrupted())
+                    return FutexWaitResult::Interrupted;
+                return FutexWaitResult::Woken;
+            }
+
+            if (remaining != UINT32_MAX)
+            {
+                remaining -= slice;
+                if (remaining == 0)
+                    return FutexWaitResult::Timeout;
+            }
+        }
+#endif
+    }
+
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+#include "../Thread.h"
+#include "../Sleep.h"
+
+#include "../../ITKCommon/ITKAbort.h"
+
+#include "./Futex.h"
+
+// number of tries before parking the thread in the futex
+#ifndef ITK_MPMC_QUEUE_SPIN_COUNT
+#define ITK_MPMC_QUEUE_SPIN_COUNT 128
+#endif
+
+namespace Platform
+{
+
+    /// \brief Lock-free bounded multi-producer/multi-consumer queue.
+    ///
+    /// Ring buffer where each cell has a sequence number (D. Vyukov algorithm).
+    /// Producers and consumers claim their positions with a single CAS.
+    ///
+    /// In blocking mode, an empty dequeue (or a full enqueue) spins a few times
+    /// and then parks the thread in a futex. The producer only makes the wake up
+    /// syscall when there is a consumer parked, so uncontended hand-offs do not
+    /// enter the kernel.
+    ///
+    /// It has the same enqueue/dequeue/size surface of the Platform::ObjectQueue.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::MPMCQueue<int> queue(1024);
+    ///
+    /// // producers
+    /// queue.enqueue(10);
+    ///
+    /// // consumers
+    /// bool isSignaled;
+    /// int v = queue.dequeue(&isSignaled);
+    /// if (isSignaled)
+    ///     return;
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T>
+    class MPMCQueue
+    {
+        struct Cell
+        {
+            std::atomic<uint32_t> sequence;
+            T data;
+        };
+
+        Cell *buffer;
+        uint32_t mask;
+        bool blocking;
+
+        char pad0[ITK_CACHE_LINE_SIZE];
+        std::atomic<uint32_t> enqueue_pos;
+        char pad1[ITK_CACHE_LINE_SIZE];
+        std::atomic<uint32_t> dequeue_pos;
+        char pad2[ITK_CACHE_LINE_SIZE];
+
+        // parking state
+        std::atomic<uint32_t> not_empty_seq;
+        std::atomic<uint32_t> consumers_waiting;
+        char pad3[ITK_CACHE_LINE_SIZE];
+        std::atomic<uint32_t> not_full_seq;
+        std::atomic<uint32_t> producers_waiting;
+        char pad4[ITK_CACHE_LINE_SIZE];
+
+        void notifyNotEmpty()
+        {
+            if (!blocking)
+                return;
+            // pairs with the fetch_add in the consumer before its last check
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (consumers_waiting.load(std::memory_order_relaxed) > 0)
+            {
+                not_empty_seq.fetch_add(1);
+                Futex::wakeOne(&not_empty_seq);
+            }
+        }
+
+        void notifyNotFull()
+        {
+            if (!blocking)
+                return;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (producers_waiting.load(std::memory_order_relaxed) > 0)
+            {
+                not_full_seq.fetch_add(1);
+                Futex::wakeOne(&not_full_seq);
+            }
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        MPMCQueue(const MPMCQueue &v) = delete;
+        MPMCQueue &operator=(const MPMCQueue &v) = delete;
+
+        /// \brief Construct the queue
+        ///
+        /// \param capacity max number of elements (rounded up to the next power of two)
+        /// \param blocking if true, dequeue waits for elements and enqueue waits for free space
+        ///
+        MPMCQueue(uint32_t capacity, bool blocking = true)
+        {
+            ITK_ABORT(capacity == 0 || capacity > 0x80000000u, "MPMCQueue capacity out of range.\n");
+
+            uint32_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            buffer = new Cell[size];
+            for (uint32_t i = 0; i < size; i++)
+                buffer[i].sequence.store(i, std::memory_order_relaxed);
+            mask = size - 1;
+            this->blocking = blocking;
+
+            enqueue_pos = 0;
+            dequeue_pos = 0;
+            not_empty_seq = 0;
+            consumers_waiting = 0;
+            not_full_seq = 0;
+            producers_waiting = 0;
+        }
+
+        ~MPMCQueue()
+        {
+            if (buffer != nullptr)
+            {
+                delete[] buffer;
+                buffer = nullptr;
+            }
+        }
+
+        uint32_t capacity() const
+        {
+            return mask + 1;
+        }
+
+        bool isBlocking() const
+        {
+            return blocking;
+        }
+
+        // never blocks, returns false if the queue is full
+        bool tryEnqueue(const T &v)
+        {
+            Cell *cell;
+            uint32_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &buffer[pos & mask];
+                uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+                int32_t dif = (int32_t)(seq - pos);
+                if (dif == 0)
+                {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0)
+                    return false;
+                else
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+
+            cell->data = v;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+
+            notifyNotEmpty();
+            return true;
+        }
+
+        // never blocks
+        // @param valueNotReaded if not null, will be set to true if there is no value to read
+        T tryDequeue(bool *valueNotReaded = nullptr)
+        {
+            Cell *cell;
+            uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &buffer[pos & mask];
+                uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+                int32_t dif = (int32_t)(seq - (pos + 1));
+                if (dif == 0)
+                {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0)
+                {
+                    if (valueNotReaded != nullptr)
+                        *valueNotReaded = true;
+                    return T();
+                }
+                else
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+
+            T result = std::move(cell->data);
+            // release resources held by the cell (shared_ptr, etc...)
+            cell->data = T();
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+
+            notifyNotFull();
+
+            if (valueNotReaded != nullptr)
+                *valueNotReaded = false;
+            return result;
+        }
+
+        /// \brief Enqueue one element
+        ///
+        /// In blocking mode, waits for free space when the queue is full.
+        ///
+        /// \return false if the queue is full (non-blocking mode) or if the current thread was interrupted
+        ///
+        bool enqueue(const T &v, bool ignoreSignal = false)
+        {
+            if (tryEnqueue(v))
+                return true;
+            if (!blocking)
+                return false;
+
+            for (int i = 0; i < ITK_MPMC_QUEUE_SPIN_COUNT; i++)
+            {
+                Sleep::cpuRelax();
+                if (tryEnqueue(v))
+                    return true;
+            }
+
+            while (true)
+            {
+                producers_waiting.fetch_add(1);
+                uint32_t seq = not_full_seq.load();
+                if (tryEnqueue(v))
+                {
+                    producers_waiting.fetch_sub(1);
+                    return true;
+                }
+                FutexWaitResult result = Futex::waitInterruptible(&not_full_seq, seq, UINT32_MAX, ignoreSignal);
+                producers_waiting.fetch_sub(1);
+                if (result == FutexWaitResult::Interrupted)
+                {
+                    // this thread may have consumed a wake up: pass it to the next producer
+                    if (size() < capacity())
+                        notifyNotFull();
+                    return false;
+                }
+            }
+        }
+
+        // @param isSignaled_or_ValueNotReaded if not null, will be set to true if the queue is signaled (in blocking mode) or if there is no value to read (in non-blocking mode)
+        T dequeue(bool *isSignaled_or_ValueNotReaded = nullptr, bool ignoreSignal = false)
+        {
+            bool empty;
+            T result = tryDequeue(&empty);
+            if (!empty || !blocking)
+            {
+                if (isSignaled_or_ValueNotReaded != nullptr)
+                    *isSignaled_or_ValueNotReaded = empty;
+                return result;
+            }
+
+            for (int i = 0; i < ITK_MPMC_QUEUE_SPIN_COUNT; i++)
+            {
+                Sleep::cpuRelax();
+                result = tryDequeue(&empty);
+                if (!empty)
+                {
+                    if (isSignaled_or_ValueNotReaded != nullptr)
+                        *isSignaled_or_ValueNotReaded = false;
+                    return result;
+                }
+            }
+
+            while (true)
+            {
+                consumers_waiting.fetch_add(1);
+                uint32_t seq = not_empty_seq.load();
+                result = tryDequeue(&empty);
+                if (!empty)
+                {
+                    consumers_waiting.fetch_sub(1);
+                    if (isSignaled_or_ValueNotReaded != nullptr)
+                        *isSignaled_or_ValueNotReaded = false;
+                    return result;
+                }
+                FutexWaitResult wait_result = Futex::waitInterruptible(&not_empty_seq, seq, UINT32_MAX, ignoreSignal);
+                consumers_waiting.fetch_sub(1);
+                if (wait_result == FutexWaitResult::Interrupted)
+                {
+                    // this thread may have consumed a wake up: pass it to the next consumer
+                    if (size() > 0)
+                        notifyNotEmpty();
+                    if (isSignaled_or_ValueNotReaded != nullptr)
+                        *isSignaled_or_ValueNotReaded = true;
+                    return T();
+                }
+            }
+        }
+
+        // approximated number of elements when there are concurrent operations
+        uint32_t size()
+        {
+            uint32_t deq = dequeue_pos.load(std::memory_order_acquire);
+            uint32_t enq = enqueue_pos.load(std::memory_order_acquire);
+            int32_t dif = (int32_t)(enq - deq);
+            if (dif < 0)
+                return 0;
+            if ((uint32_t)dif > mask + 1)
+                return mask + 1;
+            return (uint32_t)dif;
+        }
+
+        bool isSignaledFromCurrentThread() noexcept
+        {
+            return Platform::Thread::isCurrentThreadInterrupted();
+        }
+    };
+
+}
@@ -5,134 +5,409 @@
 #include "../Mutex.h"
 #include "../AutoLock.h"
 
-#include "ObjectQueue.h"
-
 #include "../../ITKCommon/ITKAbort.h"
 #include "../../ITKCommon/Memory.h"
 
+// number of free objects each thread keeps per magazine (a thread has 2 magazines per pool)
+#ifndef ITK_OBJECT_POOL_MAGAZINE_SIZE
+#define ITK_OBJECT_POOL_MAGAZINE_SIZE 32
+#endif
+
 namespace Platform {
 
+    /// \brief Thread-caching object pool.
+    ///
+    /// Objects live in slabs that are never freed until the pool is destroyed.
+    /// Each object has an intrusive header, so release does not need any lookup.
+    ///
+    /// Each thread keeps two magazines (chains of free objects) per pool in thread local
+    /// storage, indexed by a dense slot of the pool (no hash lookup). In steady state,
+    /// create and release are a pointer pop/push in the magazine. Full or empty magazines
+    /// are exchanged with a lock-free global depot (Treiber stack with tagged indices).
+    /// A thread that exits returns its magazines to the depot, if the pool is still alive.
+    ///
+    /// When ignore_placement_new_delete is true, the object is not destructed on release,
+    /// and a later create(true) can get it back with its previous state.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::ObjectPool<Message> pool;
+    ///
+    /// Message *msg = pool.create();
+    /// ...
+    /// pool.release(msg);
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
     template <class T>
     class ObjectPool {
 
-        struct ObjectPoolElement {
-            bool ignore_placement_new_delete;
-            T* data;
+        static const uint32_t NONE = UINT32_MAX;
+        static const uint32_t MAGAZINE_SIZE = ITK_OBJECT_POOL_MAGAZINE_SIZE;
+        // slab 's' has (SLAB_BASE << s) objects
+        static const uint32_t SLAB_BASE = 64;
+        static const uint32_t MAX_SLABS = 26;
+
+        static const uint8_t FLAG_IN_USE = 1 << 0;
+        static const uint8_t FLAG_CONSTRUCTED = 1 << 1;
+        static const uint8_t FLAG_IGNORE_PLACEMENT = 1 << 2;
+
+        struct Depot;
+
+        struct Node {
+            // must be the first field: T* <-> Node*
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            Depot *owner;
+            // next free node in the same magazine
+            Node *next;
+            // next magazine in the depot
+            std::atomic<uint32_t> chain_next;
+            uint32_t chain_count;
+            uint32_t index;
+            uint8_t flags;
+
+            T *data() {
+                return reinterpret_cast<T *>(&storage);
+            }
+        };
+
+        struct Magazine {
+            Node *head;
+            uint32_t count;
+
+            Magazine() {
+                head = nullptr;
+                count = 0;
+            }
+
+            Node *pop() {
+                Node *node = head;
+                head = node->next;
+                count--;
+                return node;
+            }
+
+            void push(Node *node) {
+                node->next = head;
+                head = node;
+                count++;
+            }
+        };
+
+        struct Depot {
+            // tag << 32 | index of the first node of the first magazine
+            std::atomic<uint64_t> head;
+            std::atomic<Node *> slabs[MAX_SLABS];
+            uint32_t slab_count;
+            Platform::Mutex slab_mutex;
+
+            // deleted copy constructor and assign operator, to avoid copy...
+            Depot(const Depot &v) = delete;
+            Depot &operator=(const Depot &v) = delete;
+
+            Depot() {
+                head = (uint64_t)NONE;
+                for (uint32_t i = 0; i < MAX_SLABS; i++)
+                    slabs[i] = nullptr;
+                slab_count = 0;
+            }
+
+            ~Depot() {
+                for (uint32_t s = 0; s < slab_count; s++) {
+                    Node *slab = slabs[s].load();
+                    uint32_t size = SLAB_BASE << s;
+                    for (uint32_t i = 0; i < size; i++) {
+                        if (slab[i].flags & FLAG_CONSTRUCTED)
+                            slab[i].data()->~T();
+                    }
+                    delete[] slab;
+                }
+            }
+
+            Node *nodeAt(uint32_t index) {
+                uint32_t block = index / SLAB_BASE + 1;
+                uint32_t s = 0;
+                while (block >>= 1)
+                    s++;
+                uint32_t first = SLAB_BASE * ((1u << s) - 1);
+                return &slabs[s].load(std::memory_order_acquire)[index - first];
+            }
+
+            void pushMagazine(const Magazine &magazine) {
+                Node *first = magazine.head;
+                first->chain_count = magazine.count;
+                uint64_t old_head = head.load(std::memory_order_relaxed);
+                while (true) {
+                    first->chain_next.store((uint32_t)old_head, std::memory_order_relaxed);
+                    uint64_t new_head = (((old_head >> 32) + 1) << 32) | (uint64_t)first->index;
+                    if (head.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed))
+                        return;
+                }
+            }
+
+            bool popMagazine(Magazine *magazine) {
+                uint64_t old_head = head.load(std::memory_order_acquire);
+                while (true) {
+                    uint32_t index = (uint32_t)old_head;
+                    if (index == NONE)
+                        return false;
+                    // the node memory is never freed while the depot is alive,
+                    // a stale read only makes the tagged CAS fail
+                    Node *first = nodeAt(index);
+                    uint32_t next = first->chain_next.load(std::memory_order_relaxed);
+                    uint64_t new_head = (((old_head >> 32) + 1) << 32) | (uint64_t)next;
+                    if (head.compare_exchange_weak(old_head, new_head, std::memory_order_acquire, std::memory_order_acquire)) {
+                        magazine->head = first;
+                        magazine->count = first->chain_count;
+                        return true;
+                    }
+                }
+            }
+
+            // allocate a new slab, returns the first magazine and puts the others in the depot
+            void grow(Magazine *magazine) {
+                Platform::AutoLock autoLock(&slab_mutex);
+
+                // another thread could have filled the depot
+                if (popMagazine(magazine))
+                    return;
+
+                ITK_ABORT(slab_count >= MAX_SLABS, "ERROR: ObjectPool max number of objects reached.\n");
+
+                uint32_t s = slab_count;
+                uint32_t size = SLAB_BASE << s;
+                uint32_t first_index = SLAB_BASE * ((1u << s) - 1);
+                Node *slab = new Node[size];
+                for (uint32_t i = 0; i < size; i++) {
+                    slab[i].owner = this;
+                    slab[i].next = nullptr;
+                    slab[i].chain_next = NONE;
+                    slab[i].chain_count = 0;
+                    slab[i].index = first_index + i;
+                    slab[i].flags = 0;
+                }
+                slabs[s].store(slab, std::memory_order_release);
+                slab_count++;
+
+                Magazine current;
+                bool first = true;
+                for (uint32_t i = 0; i < size; i++) {
+                    current.push(&slab[i]);
+                    if (current.count == MAGAZINE_SIZE || i == size - 1) {
+                        if (first)
+                            *magazine = current;
+                        else
+                            pushMagazine(current);
+                        first = false;
+                        current = Magazine();
+                    }
+                }
+            }
+        };
+
+        struct ThreadCache {
+            // uid of the pool that owns the magazines (0: empty entry)
+            uint64_t uid;
+            std::weak_ptr<Depot> depot;
+            Magazine loaded;
+            Magazine previous;
 
-            ObjectPoolElement() {
-                ignore_placement_new_delete = false;
-                data = nullptr;
+            ThreadCache() {
+                uid = 0;
             }
 
-            bool operator >(const ObjectPoolElement&b)const {
-                return (uintptr_t)data > (uintptr_t)b.data;
+            // return the magazines to the pool, if it is still alive
+            void flush() {
+                std::shared_ptr<Depot> depot_ref = depot.lock();
+                if (depot_ref != nullptr) {
+                    if (loaded.count > 0)
+                        depot_ref->pushMagazine(loaded);
+                    if (previous.count > 0)
+                        depot_ref->pushMagazine(previous);
+                }
+                uid = 0;
+                depot.reset();
+                loaded = Magazine();
+                previous = Magazine();
+            }
+        };
+
+        // indexed by the slot of the pool
+        struct ThreadCacheSet {
+            std::vector<ThreadCache> caches;
+
+            // thread exit: return the magazines to the pools still alive
+            ~ThreadCacheSet() {
+                for (auto &cache : caches)
+                    cache.flush();
+            }
+        };
+
+        // dense indices of the alive pools, reused after a pool is destroyed
+        struct SlotRegistry {
+            Platform::Mutex mutex;
+            std::vector<uint32_t> free_slots;
+            uint32_t slot_count;
+
+            SlotRegistry() {
+                slot_count = 0;
             }
-            bool operator <(const ObjectPoolElement&b)const {
-                return (uintptr_t)data < (uintptr_t)b.data;
+
+            uint32_t acquire() {
+                Platform::AutoLock autoLock(&mutex);
+                if (free_slots.size() > 0) {
+                    uint32_t slot = free_slots.back();
+                    free_slots.pop_back();
+                    return slot;
+                }
+                return slot_count++;
             }
-            bool operator ==(const ObjectPoolElement&b)const {
-                return (uintptr_t)data == (uintptr_t)b.data;
+
+            void release(uint32_t slot) {
+                Platform::AutoLock autoLock(&mutex);
+                free_slots.push_back(slot);
             }
         };
 
-        Platform::Mutex mutex;
+        static ThreadCacheSet &threadCacheSet() {
+            static thread_local ThreadCacheSet cache_set;
+            return cache_set;
+        }
 
-        ObjectQueue< ObjectPoolElement > available;
-        std::unordered_map< T*, ObjectPoolElement > in_use;
+        static SlotRegistry &slotRegistry() {
+            // never destructed: pools can be destroyed after the static destructors
+            static SlotRegistry *registry = new SlotRegistry();
+            return *registry;
+        }
 
+        static uint64_t nextUID() {
+            static std::atomic<uint64_t> uid_counter(0);
+            return uid_counter.fetch_add(1) + 1;
+        }
+
+        std::shared_ptr<Depot> depot;
+        uint64_t uid;
+        uint32_t slot;
         bool released;
 
+        ITK_INLINE ThreadCache *threadCache() {
+            ThreadCacheSet &cache_set = threadCacheSet();
+            if (slot < (uint32_t)cache_set.caches.size()) {
+                ThreadCache *cache = &cache_set.caches[slot];
+                if (cache->uid == uid)
+                    return cache;
+            }
+            return threadCacheSlow(cache_set);
+        }
+
+        // first use of this pool in the current thread
+        ThreadCache *threadCacheSlow(ThreadCacheSet &cache_set) {
+            if (slot >= (uint32_t)cache_set.caches.size())
+                cache_set.caches.resize(slot + 1);
+            ThreadCache *cache = &cache_set.caches[slot];
+            // the slot was used by a destroyed pool
+            cache->flush();
+            cache->uid = uid;
+            cache->depot = depot;
+            return cache;
+        }
+
+        Node *allocNode() {
+            ThreadCache *cache = threadCache();
+            if (cache->loaded.count == 0) {
+                if (cache->previous.count > 0)
+                    std::swap(cache->loaded, cache->previous);
+                else if (!depot->popMagazine(&cache->loaded))
+                    depot->grow(&cache->loaded);
+            }
+            return cache->loaded.pop();
+        }
+
+        void freeNode(Node *node) {
+            ThreadCache *cache = threadCache();
+            if (cache->loaded.count == MAGAZINE_SIZE) {
+                if (cache->previous.count == MAGAZINE_SIZE)
+                    depot->pushMagazine(cache->previous);
+                cache->previous = cache->loaded;
+                cache->loaded = Magazine();
+            }
+            cache->loaded.push(node);
+        }
+
     public:
 
         //deleted copy constructor and assign operator, to avoid copy...
         ObjectPool(const ObjectPool& v) = delete;
         ObjectPool& operator=(const ObjectPool& v) = delete;
 
-        ObjectPool() : available(false)
+        ObjectPool()
         {
+            depot = std::make_shared<Depot>();
+            uid = nextUID();
+            slot = slotRegistry().acquire();
             released = false;
         }
 
         ~ObjectPool() {
-            
-            Platform::AutoLock autoLock(&mutex);
-
-            while (available.size() > 0) {
-                ObjectPoolElement element = available.dequeue(nullptr,true);
-
-                // there is an issue on libasan
-                // it cannot call destructor of non constructed object
-                // so we need to call the placement constructor first
-                // and after that call the real destructor 
-                // (not the placement construct/destruct)
-                if (!element.ignore_placement_new_delete)
-                    new (element.data) T();
-                delete element.data;
+            // the depot destructs the objects still constructed (in use or ignore_placement_new_delete)
+            // when the last reference is released
+            // the entries of other threads are detected by the uid when the slot is reused
+            ThreadCacheSet &cache_set = threadCacheSet();
+            if (slot < (uint32_t)cache_set.caches.size() && cache_set.caches[slot].uid == uid) {
+                ThreadCache &cache = cache_set.caches[slot];
+                cache.uid = 0;
+                cache.depot.reset();
+                cache.loaded = Magazine();
+                cache.previous = Magazine();
             }
 
-            typename std::unordered_map< T*, ObjectPoolElement >::iterator it = in_use.begin();
-            while (it != in_use.end()) {
-                ObjectPoolElement element = it->second;
-                delete element.data;
-                it++;
-            }
-            in_use.clear();
-
+            depot = nullptr;
+            slotRegistry().release(slot);
             released = true;
         }
 
         T* create(bool ignore_placement_new_delete = false) {
-            Platform::AutoLock autoLock(&mutex);
-
             ITK_ABORT(released, "ERROR: trying to create element from a deleted pool");
 
-            if (available.size() > 0) {
-                ObjectPoolElement element = available.dequeue();
-                element.ignore_placement_new_delete = ignore_placement_new_delete;
+            Node *node = allocNode();
+            node->flags |= FLAG_IN_USE;
 
-                in_use[element.data] = element;
-
-                //placement new operator
-                if (!element.ignore_placement_new_delete)
-                    new (element.data) T();
-                return element.data;
+            if (ignore_placement_new_delete) {
+                // keep the previous state if the object was not destructed
+                if (!(node->flags & FLAG_CONSTRUCTED))
+                    new (node->data()) T();
+                node->flags |= FLAG_CONSTRUCTED | FLAG_IGNORE_PLACEMENT;
             }
             else {
-                ObjectPoolElement newElement;
-                newElement.ignore_placement_new_delete = ignore_placement_new_delete;
-                newElement.data = new T();
-
-                in_use[newElement.data] = newElement;
-
-                return newElement.data;
+                if (node->flags & FLAG_CONSTRUCTED)
+                    node->data()->~T();
+                //placement new operator
+                new (node->data()) T();
+                node->flags = (node->flags | FLAG_CONSTRUCTED) & ~FLAG_IGNORE_PLACEMENT;
             }
+
+            return node->data();
         }
 
         void release(T* data) {
-            Platform::AutoLock autoLock(&mutex);
-
             ITK_ABORT(released, "ERROR: trying to release element from a deleted pool\n");
 
-            //check in_use elements
-            typename std::unordered_map< T*, ObjectPoolElement >::iterator it = in_use.find(data);
-
-            if (it != in_use.end()) {
-                ObjectPoolElement removedElement = it->second;
+            Node *node = reinterpret_cast<Node *>(data);
+            ITK_ABORT(node->owner != depot.get() || !(node->flags & FLAG_IN_USE), "ERROR: deleting unknown element...\n");
 
-                in_use.erase(it);
+            node->flags &= ~FLAG_IN_USE;
 
-                //placement delete operator
-                if (!removedElement.ignore_placement_new_delete)
-                    removedElement.data->~T();
-
-                available.enqueue(removedElement);
-            }
-            else {
-                ITK_ABORT(true, "ERROR: deleting unknown element...\n");
+            //placement delete operator
+            if (!(node->flags & FLAG_IGNORE_PLACEMENT)) {
+                data->~T();
+                node->flags &= ~FLAG_CONSTRUCTED;
             }
 
+            freeNode(node);
         }
     };
 
 }
-
@@ -21,7 +21,9 @@ namespace Platform
         Descending
     };
 
-    template <typename T>
+    // INLINE_CAPACITY elements are stored inside the queue,
+    // it only allocates when more elements are pending
+    template <typename T, size_t INLINE_CAPACITY = 8>
     class ObjectQueue
     {
         Platform::Mutex mutex;
@@ -30,7 +32,7 @@ namespace Platform
 
         QueueOrder order;
 
-        SmartVector<T> queue;
+        SmartVector<T, INLINE_CAPACITY, true> queue;
 
     public:
         // deleted copy constructor and assign operator, to avoid copy...
@@ -253,6 +255,32 @@ namespace Platform
             return result;
         }
 
+        // never blocks, even in blocking mode
+        // @param valueNotReaded if not null, will be set to true if there is no value to read
+        T tryDequeue(bool *valueNotReaded = nullptr)
+        {
+            if (valueNotReaded != nullptr)
+                *valueNotReaded = true;
+
+            if (blocking && !semaphore.tryToAcquire(0, true))
+                return T();
+
+            Platform::AutoLock autoLock(&mutex);
+
+            if (queue.size() == 0)
+            {
+                ITK_ABORT(blocking, "Trying to dequeue an element from an empty queue.\n");
+                return T();
+            }
+
+            T result = std::move(queue.front());
+            queue.pop_front();
+
+            if (valueNotReaded != nullptr)
+                *valueNotReaded = false;
+            return result;
+        }
+
         // @param isSignaled_or_ValueNotReaded if not null, will be set to true if the queue is signaled (in blocking mode) or if there is no value to read (in non-blocking mode)
         // @param ignoreSignal if true, will ignore the signaled state of the queue (only in blocking mode)
         T rdequeue(bool *isSignaled_or_ValueNotReaded = nullptr, bool ignoreSignal = false)
@@ -0,0 +1,384 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+#include "../Thread.h"
+#include "../Sleep.h"
+
+#include "./Futex.h"
+
+// number of tries before parking the thread in the futex
+#ifndef ITK_SPSC_QUEUE_SPIN_COUNT
+#define ITK_SPSC_QUEUE_SPIN_COUNT 128
+#endif
+
+namespace Platform
+{
+
+    /// \brief Wait-free single-producer/single-consumer ring buffer.
+    ///
+    /// Only one thread can enqueue and only one thread can dequeue at the same time.
+    ///
+    /// The producer and consumer indices are in different cache lines, and each side
+    /// keeps a local copy of the other side index, so the shared cache line is only
+    /// read when the cached value says the queue is full (or empty).
+    ///
+    /// Elements are moved or constructed in place (no default constructor needed).
+    ///
+    /// In blocking mode, enqueue waits for free space and dequeue waits for elements,
+    /// spinning a few times before parking in a futex.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::SPSCQueue<std::vector<uint8_t>, 256> queue;
+    ///
+    /// // producer thread
+    /// std::vector<uint8_t> packet = ...;
+    /// queue.enqueue(std::move(packet));
+    ///
+    /// // consumer thread
+    /// std::vector<uint8_t> packet;
+    /// if (!queue.dequeue(&packet))
+    ///     return; // interrupted
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T, uint32_t N>
+    class SPSCQueue
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "SPSCQueue size must be a power of two.");
+        static_assert(N <= 0x80000000u, "SPSCQueue size too big.");
+
+        typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type StorageType;
+
+        bool blocking;
+
+        // consumer side
+        char pad0[ITK_CACHE_LINE_SIZE];
+        std::atomic<uint32_t> head;
+        uint32_t tail_cache;
+        std::atomic<uint32_t> consumer_parked;
+
+        // producer side
+        char pad1[ITK_CACHE_LINE_SIZE];
+        std::atomic<uint32_t> tail;
+        uint32_t head_cache;
+        std::atomic<uint32_t> producer_parked;
+        char pad2[ITK_CACHE_LINE_SIZE];
+
+        StorageType buffer[N];
+
+        T *slot(uint32_t index)
+        {
+            return reinterpret_cast<T *>(&buffer[index & (N - 1)]);
+        }
+
+        // producer: number of free slots
+        uint32_t freeSlots()
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            uint32_t free_slots = N - (t - head_cache);
+            if (free_slots == 0)
+            {
+                head_cache = head.load(std::memory_order_acquire);
+                free_slots = N - (t - head_cache);
+            }
+            return free_slots;
+        }
+
+        // consumer: number of filled slots
+        uint32_t filledSlots()
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            uint32_t filled = tail_cache - h;
+            if (filled == 0)
+            {
+                tail_cache = tail.load(std::memory_order_acquire);
+                filled = tail_cache - h;
+            }
+            return filled;
+        }
+
+        void publishTail(uint32_t t)
+        {
+            tail.store(t, std::memory_order_release);
+            if (!blocking)
+                return;
+            // pairs with the consumer_parked store before the consumer last check
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (consumer_parked.load(std::memory_order_relaxed))
+                Futex::wakeOne(&tail);
+        }
+
+        void publishHead(uint32_t h)
+        {
+            head.store(h, std::memory_order_release);
+            if (!blocking)
+                return;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (producer_parked.load(std::memory_order_relaxed))
+                Futex::wakeOne(&head);
+        }
+
+        // producer: wait for at least one free slot
+        bool waitFreeSlot(bool ignoreSignal)
+        {
+            if (freeSlots() > 0)
+                return true;
+            if (!blocking)
+                return false;
+
+            for (int i = 0; i < ITK_SPSC_QUEUE_SPIN_COUNT; i++)
+            {
+                Sleep::cpuRelax();
+                if (freeSlots() > 0)
+                    return true;
+            }
+
+            while (true)
+            {
+                producer_parked.store(1);
+                uint32_t h = head.load();
+                head_cache = h;
+                if (freeSlots() > 0)
+                {
+                    producer_parked.store(0, std::memory_order_relaxed);
+                    return true;
+                }
+                FutexWaitResult result = Futex::waitInterruptible(&head, h, UINT32_MAX, ignoreSignal);
+                producer_parked.store(0, std::memory_order_relaxed);
+                if (result == FutexWaitResult::Interrupted)
+                    return freeSlots() > 0;
+            }
+        }
+
+        // consumer: wait for at least one element
+        bool waitFilledSlot(bool ignoreSignal)
+        {
+            if (filledSlots() > 0)
+                return true;
+            if (!blocking)
+                return false;
+
+            for (int i = 0; i < ITK_SPSC_QUEUE_SPIN_COUNT; i++)
+            {
+                Sleep::cpuRelax();
+                if (filledSlots() > 0)
+                    return true;
+            }
+
+            while (true)
+            {
+                consumer_parked.store(1);
+                uint32_t t = tail.load();
+                tail_cache = t;
+                if (filledSlots() > 0)
+                {
+                    consumer_parked.store(0, std::memory_order_relaxed);
+                    return true;
+                }
+                FutexWaitResult result = Futex::waitInterruptible(&tail, t, UINT32_MAX, ignoreSignal);
+                consumer_parked.store(0, std::memory_order_relaxed);
+                if (result == FutexWaitResult::Interrupted)
+                    return filledSlots() > 0;
+            }
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        SPSCQueue(const SPSCQueue &v) = delete;
+        SPSCQueue &operator=(const SPSCQueue &v) = delete;
+
+        SPSCQueue(bool blocking = true) noexcept
+        {
+            this->blocking = blocking;
+            head = 0;
+            tail_cache = 0;
+            consumer_parked = 0;
+            tail = 0;
+            head_cache = 0;
+            producer_parked = 0;
+        }
+
+        ~SPSCQueue()
+        {
+            uint32_t h = head.load();
+            uint32_t t = tail.load();
+            for (; h != t; h++)
+                slot(h)->~T();
+        }
+
+        static constexpr uint32_t capacity()
+        {
+            return N;
+        }
+
+        bool isBlocking() const
+        {
+            return blocking;
+        }
+
+        // approximated number of elements when called from a thread that is not the producer or the consumer
+        uint32_t size()
+        {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        //
+        // producer
+        //
+
+        // never blocks, returns false if the queue is full
+        template <typename... _param_args>
+        bool tryEmplace(_param_args &&...args)
+        {
+            if (freeSlots() == 0)
+                return false;
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            new (slot(t)) T(std::forward<_param_args>(args)...);
+            publishTail(t + 1);
+            return true;
+        }
+
+        bool tryEnqueue(T &&v)
+        {
+            return tryEmplace(std::move(v));
+        }
+
+        bool tryEnqueue(const T &v)
+        {
+            return tryEmplace(v);
+        }
+
+        /// \brief Construct one element in place
+        ///
+        /// In blocking mode, waits for free space when the queue is full.
+        ///
+        /// \return false if the queue is full (non-blocking mode) or if the current thread was interrupted
+        ///
+        template <typename... _param_args>
+        bool emplace(_param_args &&...args)
+        {
+            return emplaceWithSignal(false, std::forward<_param_args>(args)...);
+        }
+
+        /// \brief Construct one element in place
+        ///
+        /// \param ignoreSignal if true, the blocking wait is not interrupted by Thread::interrupt()
+        ///
+        template <typename... _param_args>
+        bool emplaceWithSignal(bool ignoreSignal, _param_args &&...args)
+        {
+            if (!waitFreeSlot(ignoreSignal))
+                return false;
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            new (slot(t)) T(std::forward<_param_args>(args)...);
+            publishTail(t + 1);
+            return true;
+        }
+
+        bool enqueue(T &&v, bool ignoreSignal = false)
+        {
+            return emplaceWithSignal(ignoreSignal, std::move(v));
+        }
+
+        bool enqueue(const T &v, bool ignoreSignal = false)
+        {
+            return emplaceWithSignal(ignoreSignal, v);
+        }
+
+        /// \brief Move a span of elements into the queue
+        ///
+        /// The consumer is notified once for the whole batch.
+        /// In blocking mode, waits until all elements are enqueued.
+        ///
+        /// \return the number of elements moved from the input (less than count if the queue is full in non-blocking mode or if the current thread was interrupted)
+        ///
+        uint32_t enqueueBatch(T *items, uint32_t count, bool ignoreSignal = false)
+        {
+            uint32_t done = 0;
+            while (done < count)
+            {
+                if (!waitFreeSlot(ignoreSignal))
+                    break;
+                uint32_t t = tail.load(std::memory_order_relaxed);
+                uint32_t to_write = freeSlots();
+                if (to_write > count - done)
+                    to_write = count - done;
+                for (uint32_t i = 0; i < to_write; i++)
+                    new (slot(t + i)) T(std::move(items[done + i]));
+                done += to_write;
+                publishTail(t + to_write);
+            }
+            return done;
+        }
+
+        //
+        // consumer
+        //
+
+        // never blocks, returns false if there is no element to read
+        bool tryDequeue(T *out)
+        {
+            if (filledSlots() == 0)
+                return false;
+            uint32_t h = head.load(std::memory_order_relaxed);
+            T *item = slot(h);
+            *out = std::move(*item);
+            item->~T();
+            publishHead(h + 1);
+            return true;
+        }
+
+        /// \brief Move the next element to out
+        ///
+        /// In blocking mode, waits for an element when the queue is empty.
+        ///
+        /// \return false if there is no element (non-blocking mode) or if the current thread was interrupted
+        ///
+        bool dequeue(T *out, bool ignoreSignal = false)
+        {
+            if (!waitFilledSlot(ignoreSignal))
+                return false;
+            uint32_t h = head.load(std::memory_order_relaxed);
+            T *item = slot(h);
+            *out = std::move(*item);
+            item->~T();
+            publishHead(h + 1);
+            return true;
+        }
+
+        /// \brief Move up to max_count elements to out
+        ///
+        /// In blocking mode, waits for at least one element.
+        ///
+        /// \return the number of elements read (zero if the queue is empty in non-blocking mode or if the current thread was interrupted)
+        ///
+        uint32_t dequeueBatch(T *out, uint32_t max_count, bool ignoreSignal = false)
+        {
+            if (max_count == 0 || !waitFilledSlot(ignoreSignal))
+                return 0;
+            uint32_t h = head.load(std::memory_order_relaxed);
+            uint32_t to_read = filledSlots();
+            if (to_read > max_count)
+                to_read = max_count;
+            for (uint32_t i = 0; i < to_read; i++)
+            {
+                T *item = slot(h + i);
+                out[i] = std::move(*item);
+                item->~T();
+            }
+            publishHead(h + to_read);
+            return to_read;
+        }
+
+        bool isSignaledFromCurrentThread() noexcept
+        {
+            return Platform::Thread::isCurrentThreadInterrupted();
+        }
+    };
+
+}
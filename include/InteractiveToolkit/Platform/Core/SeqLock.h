@@ -0,0 +1,134 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+#include "../Sleep.h"
+
+// number of read retries before yielding the CPU to the writer
+#ifndef ITK_SEQLOCK_SPIN_COUNT
+#define ITK_SEQLOCK_SPIN_COUNT 1024
+#endif
+
+namespace Platform
+{
+
+    /// \brief Sequence lock for small trivially copyable values with one writer and many readers.
+    ///
+    /// The writer never waits: it makes the sequence odd, stores the value and makes
+    /// the sequence even again. A reader copies the value and retries if the sequence
+    /// changed (or was odd) during the copy. Readers do not write to shared memory,
+    /// so they scale with the number of threads.
+    ///
+    /// The value is stored as relaxed atomic words, so a torn copy is never
+    /// observed by the caller and there is no data race.
+    ///
+    /// Only one thread can call write at the same time.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// struct InputState { float x, y; uint32_t buttons; };
+    /// Platform::SeqLock<InputState> input_state;
+    ///
+    /// // writer thread (60 Hz)
+    /// input_state.write(state);
+    ///
+    /// // any reader thread
+    /// InputState state = input_state.read();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock<T> requires a trivially copyable T");
+
+        static const size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> sequence;
+        std::atomic<uint64_t> words[WORD_COUNT];
+
+        void storeWords(const T &v)
+        {
+            uint64_t aux[WORD_COUNT];
+            aux[WORD_COUNT - 1] = 0;
+            memcpy(aux, &v, sizeof(T));
+            for (size_t i = 0; i < WORD_COUNT; i++)
+                words[i].store(aux[i], std::memory_order_relaxed);
+        }
+
+        void loadWords(T *v) const
+        {
+            uint64_t aux[WORD_COUNT];
+            for (size_t i = 0; i < WORD_COUNT; i++)
+                aux[i] = words[i].load(std::memory_order_relaxed);
+            memcpy(v, aux, sizeof(T));
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        SeqLock(const SeqLock &v) = delete;
+        SeqLock &operator=(const SeqLock &v) = delete;
+
+        SeqLock(const T &initial = T())
+        {
+            sequence = 0;
+            storeWords(initial);
+        }
+
+        // wait-free, single writer
+        void write(const T &v)
+        {
+            uint32_t seq = sequence.load(std::memory_order_relaxed);
+            sequence.store(seq + 1, std::memory_order_relaxed);
+            // the odd sequence must be visible before the new words
+            std::atomic_thread_fence(std::memory_order_release);
+            storeWords(v);
+            sequence.store(seq + 2, std::memory_order_release);
+        }
+
+        /// \brief Try to copy the value once.
+        ///
+        /// \return false if a write was in progress
+        ///
+        bool tryRead(T *v) const
+        {
+            uint32_t seq_begin = sequence.load(std::memory_order_acquire);
+            if ((seq_begin & 1) != 0)
+                return false;
+            loadWords(v);
+            // the words must be read before the sequence check
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return sequence.load(std::memory_order_relaxed) == seq_begin;
+        }
+
+        // lock-free, retries while a write is in progress
+        T read() const
+        {
+            T result;
+            uint32_t spin = 0;
+            while (!tryRead(&result))
+            {
+                // the writer may be preempted in the middle of a write:
+                // give it the CPU instead of burning the time slice
+                if (spin < ITK_SEQLOCK_SPIN_COUNT)
+                {
+                    Sleep::cpuRelax();
+                    spin++;
+                }
+                else
+                    Sleep::yield();
+            }
+            return result;
+        }
+
+        // number of writes
+        uint32_t version() const
+        {
+            return sequence.load(std::memory_order_acquire) >> 1;
+        }
+    };
+
+}
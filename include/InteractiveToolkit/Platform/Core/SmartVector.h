@@ -20,7 +20,95 @@
 namespace Platform
 {
 
-    template <typename T, size_t MIN_CAPACITY = 8>
+    /// \brief Block of a SmartVector with inline storage.
+    ///
+    /// Keeps N elements inside the object, and points to a heap block
+    /// after the SmartVector grows beyond N elements.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T, size_t N>
+    class SmartVectorInlineBlock
+    {
+        T inline_data[N];
+        std::unique_ptr<T[]> heap_data;
+        T *data;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        SmartVectorInlineBlock(const SmartVectorInlineBlock &v) = delete;
+        SmartVectorInlineBlock &operator=(const SmartVectorInlineBlock &v) = delete;
+
+        ITK_INLINE SmartVectorInlineBlock() noexcept : data(inline_data)
+        {
+        }
+
+        // spill to a heap block
+        ITK_INLINE SmartVectorInlineBlock &operator=(std::unique_ptr<T[]> &&block) noexcept
+        {
+            heap_data = std::move(block);
+            data = (heap_data != nullptr) ? heap_data.get() : inline_data;
+            return *this;
+        }
+
+        // steals the heap block, or moves the inline elements slot by slot
+        // (the cyclic indexes of the source stay valid)
+        ITK_INLINE SmartVectorInlineBlock &operator=(SmartVectorInlineBlock &&other) noexcept
+        {
+            if (other.isInline())
+            {
+                for (size_t i = 0; i < N; i++)
+                    inline_data[i] = std::move(other.inline_data[i]);
+                heap_data = nullptr;
+                data = inline_data;
+            }
+            else
+            {
+                heap_data = std::move(other.heap_data);
+                data = heap_data.get();
+                other.data = other.inline_data;
+            }
+            return *this;
+        }
+
+        // returns the heap block and points back to the inline storage
+        ITK_INLINE std::unique_ptr<T[]> releaseHeap() noexcept
+        {
+            data = inline_data;
+            return std::move(heap_data);
+        }
+
+        ITK_INLINE bool isInline() const noexcept
+        {
+            return data == inline_data;
+        }
+
+        ITK_INLINE T &operator[](size_t index) noexcept { return data[index]; }
+        ITK_INLINE const T &operator[](size_t index) const noexcept { return data[index]; }
+
+        // there is always a block to write to
+        ITK_INLINE bool operator==(std::nullptr_t) const noexcept { return false; }
+    };
+
+    /// \brief Cyclic vector with O(1) insertion and removal at both ends.
+    ///
+    /// When INLINE_STORAGE is true, the first MIN_CAPACITY elements are stored
+    /// inside the object. It only allocates when it grows beyond MIN_CAPACITY,
+    /// and shrink_to_fit goes back to the inline storage.
+    ///
+    /// Moving (or swapping) an inline vector moves its elements instead of a pointer.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// // up to 16 tasks without heap allocation
+    /// Platform::SmartVector<Task, 16, true> tasks;
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T, size_t MIN_CAPACITY = 8, bool INLINE_STORAGE = false>
     class SmartVector
     {
     public:
@@ -34,7 +122,14 @@ namespace Platform
         using const_pointer = const T *;
 
     private:
-        std::unique_ptr<T[]> cyclic_block_array;
+        using InlineStorageTag = std::integral_constant<bool, INLINE_STORAGE>;
+        using BlockType = typename std::conditional<INLINE_STORAGE,
+                                                    SmartVectorInlineBlock<T, MIN_CAPACITY>,
+                                                    std::unique_ptr<T[]>>::type;
+        // capacity of an empty vector
+        static constexpr size_t INLINE_CAPACITY = INLINE_STORAGE ? MIN_CAPACITY : 0;
+
+        BlockType cyclic_block_array;
         size_t m_capacity;
 
         size_t _start;
@@ -238,7 +333,7 @@ namespace Platform
             size_t idx;
             size_t item_count;
 
-            friend class SmartVector<T>;
+            friend class SmartVector;
         };
 
         class const_iterator
@@ -432,7 +527,7 @@ namespace Platform
             size_t idx;
             size_t item_count;
 
-            friend class SmartVector<T>;
+            friend class SmartVector;
         };
 
         ITK_INLINE iterator begin() noexcept { return iterator(this, (internal_size) ? _start : m_capacity, internal_size); }
@@ -828,10 +923,48 @@ namespace Platform
             }
         }
 
+        ITK_INLINE bool shrink_to_inline(std::false_type) noexcept
+        {
+            return false;
+        }
+
+        // moves the elements from the heap block back to the inline storage
+        ITK_INLINE bool shrink_to_inline(std::true_type) noexcept
+        {
+            if (internal_size > MIN_CAPACITY || cyclic_block_array.isInline())
+                return false;
+
+            std::unique_ptr<T[]> heap_block = cyclic_block_array.releaseHeap();
+
+            if (internal_size > 0)
+            {
+                if (_start < _end)
+                {
+                    // Normal case, no wrap around
+                    for (size_t i = 0; i < internal_size; i++)
+                        cyclic_block_array[i] = std::move(heap_block[_start + i]);
+                }
+                else
+                {
+                    // Wrap around case
+                    size_t first_part_size = m_capacity - _start;
+                    for (size_t i = 0; i < first_part_size; i++)
+                        cyclic_block_array[i] = std::move(heap_block[_start + i]);
+                    for (size_t i = 0; i < _end; i++)
+                        cyclic_block_array[first_part_size + i] = std::move(heap_block[i]);
+                }
+            }
+
+            m_capacity = MIN_CAPACITY;
+            _start = 0;
+            _end = internal_size;
+            return true;
+        }
+
     public:
         ITK_INLINE SmartVector(int initial_size = 0) noexcept
         {
-            m_capacity = 0;
+            m_capacity = INLINE_CAPACITY;
             _start = 0;
             _end = 0;
             internal_size = 0;
@@ -839,7 +972,7 @@ namespace Platform
         }
         ITK_INLINE SmartVector(const SmartVector &other) noexcept
         {
-            m_capacity = 0;
+            m_capacity = INLINE_CAPACITY;
             if (other.internal_size > m_capacity || cyclic_block_array == nullptr)
             {
                 m_capacity = other.internal_size;
@@ -882,14 +1015,14 @@ namespace Platform
             _end = other._end;
             internal_size = other.internal_size;
             cyclic_block_array = std::move(other.cyclic_block_array);
-            other.m_capacity = 0;
+            other.m_capacity = INLINE_CAPACITY;
             other._start = 0;
             other._end = 0;
             other.internal_size = 0;
         }
         ITK_INLINE SmartVector(std::initializer_list<T> ilist) noexcept
         {
-            m_capacity = 0;
+            m_capacity = INLINE_CAPACITY;
             _start = 0;
             _end = 0;
             internal_size = 0;
@@ -950,7 +1083,7 @@ namespace Platform
                 _end = other._end;
                 internal_size = other.internal_size;
                 cyclic_block_array = std::move(other.cyclic_block_array);
-                other.m_capacity = 0;
+                other.m_capacity = INLINE_CAPACITY;
                 other._start = 0;
                 other._end = 0;
                 other.internal_size = 0;
@@ -1008,7 +1141,7 @@ namespace Platform
                 if (new_capacity < MIN_CAPACITY)
                     new_capacity = MIN_CAPACITY;
 
-                if (new_capacity < m_capacity)
+                if (new_capacity < m_capacity && !shrink_to_inline(InlineStorageTag()))
                 {
                     auto new_cyclic_block_array = STL_Tools::make_unique<T[]>(new_capacity);
 
@@ -1270,6 +1403,20 @@ namespace Platform
         }
 
         ITK_INLINE void swap(SmartVector &other) noexcept
+        {
+            swap_storage(other, InlineStorageTag());
+        }
+
+    private:
+        ITK_INLINE void swap_storage(SmartVector &other, std::true_type) noexcept
+        {
+            // inline elements cannot be exchanged by pointer
+            SmartVector aux(std::move(other));
+            other = std::move(*this);
+            *this = std::move(aux);
+        }
+
+        ITK_INLINE void swap_storage(SmartVector &other, std::false_type) noexcept
         {
             std::swap(m_capacity, other.m_capacity);
             std::swap(_start, other._start);
@@ -1278,6 +1425,8 @@ namespace Platform
             cyclic_block_array.swap(other.cyclic_block_array);
         }
 
+    public:
+
         // STL-compatible comparison operators
         ITK_INLINE bool operator==(const SmartVector &other) const noexcept
         {
@@ -1708,8 +1857,8 @@ namespace Platform
     };
 
     // Global swap function for STL compatibility
-    template <typename T, size_t MIN_CAPACITY>
-    ITK_INLINE void swap(SmartVector<T, MIN_CAPACITY> &lhs, SmartVector<T, MIN_CAPACITY> &rhs) noexcept
+    template <typename T, size_t MIN_CAPACITY, bool INLINE_STORAGE>
+    ITK_INLINE void swap(SmartVector<T, MIN_CAPACITY, INLINE_STORAGE> &lhs, SmartVector<T, MIN_CAPACITY, INLINE_STORAGE> &rhs) noexcept
     {
         lhs.swap(rhs);
     }
@@ -0,0 +1,121 @@
+#pragma once
+
+// #include "../platform_common.h"
+#include "../../common.h"
+
+namespace Platform
+{
+
+    /// \brief Triple buffer to publish a state from one writer thread to one reader thread.
+    ///
+    /// The writer fills the back buffer and publishes it by exchanging the index with
+    /// the middle buffer. The reader exchanges its front buffer with the middle buffer
+    /// when there is a new publication. Both sides are wait-free (one atomic exchange),
+    /// never copy the value and always see a complete state.
+    ///
+    /// Only the latest publication is kept: the reader skips intermediate states.
+    /// The buffer returned by writeBuffer() contains an old state, the writer must
+    /// set all fields before publish().
+    ///
+    /// Many reader threads can use a SeqLock, or one Snapshot each.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::Snapshot<std::vector<Transform>> transforms;
+    ///
+    /// // simulation thread
+    /// std::vector<Transform> &next = transforms.writeBuffer();
+    /// fillTransforms(&next);
+    /// transforms.publish();
+    ///
+    /// // render thread
+    /// const std::vector<Transform> &current = transforms.read();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T>
+    class Snapshot
+    {
+        static const uint8_t INDEX_MASK = 0x3;
+        // the middle buffer has a publication not read yet
+        static const uint8_t NEW_DATA = 0x4;
+
+        T buffers[3];
+
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint8_t> middle;
+        // used only by the writer
+        alignas(ITK_CACHE_LINE_SIZE) uint8_t back;
+        // used only by the reader
+        alignas(ITK_CACHE_LINE_SIZE) uint8_t front;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        Snapshot(const Snapshot &v) = delete;
+        Snapshot &operator=(const Snapshot &v) = delete;
+
+        Snapshot(const T &initial = T())
+        {
+            for (int i = 0; i < 3; i++)
+                buffers[i] = initial;
+            back = 0;
+            middle = 1;
+            front = 2;
+        }
+
+        // writer side: buffer to fill before publish()
+        T &writeBuffer()
+        {
+            return buffers[back];
+        }
+
+        // writer side
+        void publish()
+        {
+            uint8_t old_middle = middle.exchange(back | NEW_DATA, std::memory_order_acq_rel);
+            back = old_middle & INDEX_MASK;
+        }
+
+        // writer side: copy the value to the back buffer and publish it
+        void write(const T &v)
+        {
+            buffers[back] = v;
+            publish();
+        }
+
+        // reader side: true if there is a publication not read yet
+        bool hasNewData() const
+        {
+            return (middle.load(std::memory_order_relaxed) & NEW_DATA) != 0;
+        }
+
+        /// \brief Reader side: take the latest publication, if any.
+        ///
+        /// \return true if the front buffer changed
+        ///
+        bool update()
+        {
+            if (!hasNewData())
+                return false;
+            uint8_t old_middle = middle.exchange(front, std::memory_order_acq_rel);
+            front = old_middle & INDEX_MASK;
+            return true;
+        }
+
+        // reader side: latest publication, valid until the next read/update
+        const T &read()
+        {
+            update();
+            return buffers[front];
+        }
+
+        // reader side: the front buffer without checking new publications
+        const T &current() const
+        {
+            return buffers[front];
+        }
+    };
+
+}
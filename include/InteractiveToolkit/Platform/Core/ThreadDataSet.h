@@ -71,9 +71,18 @@ namespace Platform
             semaphore.releaseCount(1);
         }
 
+        // Thread registered in the calling OS thread, nullptr if not registered.
+        // Avoids the map lookup in Thread::getCurrentThread().
+        static ITK_INLINE Thread *&currentThreadSlot()
+        {
+            static thread_local Thread *current = nullptr;
+            return current;
+        }
+
         void registerThread(Thread *thread)
         {
             ThreadIdentifier tid = GetCurrentThreadId_Custom();
+            currentThreadSlot() = (Thread *)(thread);
 
             register_mutex.lock();
 
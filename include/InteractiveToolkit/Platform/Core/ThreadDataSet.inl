@@ -2,12 +2,16 @@
 
 #include "ThreadDataSet.h"
 #include "../Thread.h"
+#include "EpochManager.h"
 
 namespace Platform
 {
 
     inline void ThreadDataSet::unregisterThread(Thread *thread)
     {
+        // pending EBR objects of this thread are moved to the orphan list
+        EpochManager::Instance()->threadExit();
+
         ThreadIdentifier tid = GetCurrentThreadId_Custom();
         MapT::iterator it;
 
@@ -32,6 +36,9 @@ namespace Platform
 
         register_mutex.unlock();
 
+        if (currentThreadSlot() == result)
+            currentThreadSlot() = nullptr;
+
         // mark thread exited
         if (result != nullptr)
             result->setExited();
@@ -0,0 +1,719 @@
+#pragma once
+
+#include "platform_common.h"
+#include "../EventCore/Callback.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "Mutex.h"
+#include "AutoLock.h"
+#include "Thread.h"
+#include "Sleep.h"
+#include "ThreadPool.h"
+#include "SocketTCP.h"
+#include "Core/Futex.h"
+
+// stack size of each fiber
+#ifndef ITK_FIBER_STACK_SIZE
+#define ITK_FIBER_STACK_SIZE (128 * 1024)
+#endif
+
+// Windows: the IO poller cannot be woken by a pipe, it checks the new waits in this interval
+#ifndef ITK_FIBER_POLL_INTERVAL_MS
+#define ITK_FIBER_POLL_INTERVAL_MS 10
+#endif
+
+namespace Platform
+{
+
+    class FiberExecutor;
+
+    /// \brief Lock for the short critical sections of the fiber wait lists.
+    ///
+    /// It does not use thread local storage (as the recursive Platform::Mutex does),
+    /// so it can be locked again after a fiber resumes in another thread.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class FiberSpinLock
+    {
+        std::atomic<bool> locked;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        FiberSpinLock(const FiberSpinLock &v) = delete;
+        FiberSpinLock &operator=(const FiberSpinLock &v) = delete;
+
+        FiberSpinLock()
+        {
+            locked = false;
+        }
+
+        void lock()
+        {
+            while (locked.exchange(true, std::memory_order_acquire))
+            {
+                while (locked.load(std::memory_order_relaxed))
+                    Sleep::cpuRelax();
+            }
+        }
+
+        void unlock()
+        {
+            locked.store(false, std::memory_order_release);
+        }
+    };
+
+    /// \brief Execution context (stack and registers) of a task spawned in a FiberExecutor.
+    ///
+    /// The fields are managed by the FiberExecutor, use FiberExecutor::currentFiber(),
+    /// FiberExecutor::suspend() and FiberExecutor::resume() to build awaitable objects.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class Fiber
+    {
+        enum State : uint32_t
+        {
+            Running,
+            // switching back to the worker
+            Suspending,
+            Suspended,
+            // resume requested while Running or Suspending
+            ResumePending
+        };
+
+        FiberExecutor *executor;
+        EventCore::Callback<void()> task;
+        std::atomic<uint32_t> state;
+        bool finished;
+
+#if defined(_WIN32)
+        LPVOID handle;
+        LPVOID return_handle;
+#else
+        ucontext_t context;
+        ucontext_t *return_context;
+        uint8_t *stack_memory;
+        size_t stack_memory_size;
+#endif
+
+        Fiber()
+        {
+            executor = nullptr;
+            state = Running;
+            finished = false;
+#if defined(_WIN32)
+            handle = nullptr;
+            return_handle = nullptr;
+#else
+            return_context = nullptr;
+            stack_memory = nullptr;
+            stack_memory_size = 0;
+#endif
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        Fiber(const Fiber &v) = delete;
+        Fiber &operator=(const Fiber &v) = delete;
+
+        friend class FiberExecutor;
+    };
+
+    /// \brief Run thousands of blocking-style tasks over the threads of a ThreadPool.
+    ///
+    /// Each spawned task runs in a fiber with its own stack (ucontext on Linux/macOS,
+    /// Win32 fibers on Windows). When a task waits (FiberSemaphore, FiberQueue, socket IO),
+    /// its fiber is suspended and the pool thread runs other fibers.
+    /// When the wait completes, the fiber is posted to the pool again, and can resume in any thread.
+    ///
+    /// Socket IO uses non-blocking sockets and one poller thread (poll/WSAPoll).
+    /// Calls that cannot be polled (QueueIPC, files, ...) can be moved to
+    /// a blocking pool with awaitBlocking.
+    ///
+    /// Blocking calls (Platform::Semaphore, ObjectQueue, blocking sockets) inside a fiber
+    /// block the pool thread. Thread local references must not be kept across waits,
+    /// because the fiber can resume in another thread.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::ThreadPool threadPool;
+    /// Platform::FiberExecutor executor(&threadPool);
+    ///
+    /// Platform::SocketTCPAccept server(false);
+    /// server.bindAndListen("0.0.0.0", 8080);
+    ///
+    /// executor.spawn([&](){
+    ///     while (true) {
+    ///         Platform::SocketTCP *client = new Platform::SocketTCP();
+    ///         if (executor.accept(&server, client) != Platform::SOCKET_RESULT_OK) {
+    ///             delete client;
+    ///             break;
+    ///         }
+    ///         client->setBlocking(false);
+    ///         // echo of fixed size messages
+    ///         executor.spawn([&executor, client](){
+    ///             uint8_t buffer[64];
+    ///             while (executor.read(client, buffer, 64) == Platform::SOCKET_RESULT_OK)
+    ///                 executor.write(client, buffer, 64);
+    ///             delete client;
+    ///         });
+    ///     }
+    /// });
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class FiberExecutor : public EventCore::HandleCallback
+    {
+    public:
+        using CallbackType = typename EventCore::Callback<void()>;
+
+#if defined(_WIN32)
+        using NativeFD = SOCKET;
+#else
+        using NativeFD = int;
+#endif
+
+    private:
+#if defined(_WIN32)
+        using PollFD = WSAPOLLFD;
+#else
+        using PollFD = struct pollfd;
+#endif
+
+        struct IOWait
+        {
+            NativeFD fd;
+            short events;
+            Fiber *fiber;
+            bool interrupted;
+        };
+
+        ThreadPool *pool;
+        uint32_t stack_size;
+        std::atomic<uint32_t> active_fibers;
+
+        Platform::Mutex blocking_mutex;
+        ThreadPool *blocking_pool;
+        bool owns_blocking_pool;
+
+        Platform::Mutex io_mutex;
+        std::vector<IOWait *> io_waits;
+        bool io_closing;
+        Platform::Thread *io_thread;
+#if !defined(_WIN32)
+        int wake_pipe[2];
+#endif
+
+        // not inlined: a fiber can resume in another thread,
+        // and the address of the thread local must be read again
+#if defined(_MSC_VER)
+        __declspec(noinline)
+#else
+        __attribute__((noinline))
+#endif
+        static Fiber *&currentFiberSlot()
+        {
+            static thread_local Fiber *current = nullptr;
+            return current;
+        }
+
+#if defined(_WIN32)
+        static VOID WINAPI fiberEntry(LPVOID param)
+        {
+            Fiber *fiber = (Fiber *)param;
+            fiber->task();
+            fiber->finished = true;
+            SwitchToFiber(fiber->return_handle);
+        }
+#else
+        // makecontext only forwards int arguments
+        static void fiberEntry(uint32_t low, uint32_t high)
+        {
+            Fiber *fiber = (Fiber *)(uintptr_t)(((uint64_t)high << 32) | (uint64_t)low);
+            fiber->task();
+            fiber->finished = true;
+            setcontext(fiber->return_context);
+        }
+#endif
+
+        Fiber *createFiber(const CallbackType &task)
+        {
+            Fiber *fiber = new Fiber();
+            fiber->executor = this;
+            fiber->task = task;
+#if defined(_WIN32)
+            // CreateFiber does not need the current thread to be a fiber
+            fiber->handle = CreateFiber(stack_size, &FiberExecutor::fiberEntry, fiber);
+            ITK_ABORT(fiber->handle == nullptr, "Error to create fiber. Message: %s\n", ITKPlatformUtil::win32_GetLastErrorToString().c_str());
+#else
+            size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+            size_t size = ((stack_size + page_size - 1) / page_size) * page_size + page_size;
+            void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            ITK_ABORT(memory == MAP_FAILED, "Error to allocate fiber stack. Message: %s\n", strerror(errno));
+            // guard page: the stack grows down
+            mprotect(memory, page_size, PROT_NONE);
+            fiber->stack_memory = (uint8_t *)memory;
+            fiber->stack_memory_size = size;
+
+            getcontext(&fiber->context);
+            fiber->context.uc_stack.ss_sp = fiber->stack_memory + page_size;
+            fiber->context.uc_stack.ss_size = size - page_size;
+            fiber->context.uc_link = nullptr;
+            uint64_t address = (uint64_t)(uintptr_t)fiber;
+            makecontext(&fiber->context, (void (*)())&FiberExecutor::fiberEntry, 2,
+                        (uint32_t)(address & UINT64_C(0xffffffff)), (uint32_t)(address >> 32));
+#endif
+            return fiber;
+        }
+
+        static void destroyFiber(Fiber *fiber)
+        {
+#if defined(_WIN32)
+            DeleteFiber(fiber->handle);
+#else
+            munmap(fiber->stack_memory, fiber->stack_memory_size);
+#endif
+            delete fiber;
+        }
+
+        void schedule(Fiber *fiber)
+        {
+            pool->postTask(CallbackType([fiber]()
+                                        { FiberExecutor::runFiber(fiber); }));
+        }
+
+        // runs the fiber in the current thread until it suspends or finishes
+        static void runFiber(Fiber *fiber)
+        {
+            Fiber *&current = currentFiberSlot();
+            Fiber *previous = current;
+            current = fiber;
+
+#if defined(_WIN32)
+            if (!IsThreadAFiber())
+                ConvertThreadToFiber(nullptr);
+            fiber->return_handle = GetCurrentFiber();
+            SwitchToFiber(fiber->handle);
+#else
+            ucontext_t caller;
+            fiber->return_context = &caller;
+            swapcontext(&caller, &fiber->context);
+#endif
+
+            current = previous;
+
+            if (fiber->finished)
+            {
+                FiberExecutor *executor = fiber->executor;
+                destroyFiber(fiber);
+                if (executor->active_fibers.fetch_sub(1) == 1)
+                    Futex::wakeAll(&executor->active_fibers);
+                return;
+            }
+
+            uint32_t expected = Fiber::Suspending;
+            if (!fiber->state.compare_exchange_strong(expected, (uint32_t)Fiber::Suspended))
+            {
+                // resumed while switching out
+                fiber->state = Fiber::Running;
+                fiber->executor->schedule(fiber);
+            }
+        }
+
+        static void switchOut(Fiber *fiber)
+        {
+#if defined(_WIN32)
+            SwitchToFiber(fiber->return_handle);
+#else
+            swapcontext(&fiber->context, fiber->return_context);
+#endif
+        }
+
+        void wakeIOThread()
+        {
+#if !defined(_WIN32)
+            char value = 1;
+            ssize_t written = ::write(wake_pipe[1], &value, 1);
+            (void)written;
+#endif
+        }
+
+        void runIO()
+        {
+            std::vector<IOWait *> waits;
+            std::vector<PollFD> fds;
+            std::vector<Fiber *> ready;
+
+            while (true)
+            {
+                {
+                    Platform::AutoLock autoLock(&io_mutex);
+                    if (io_closing)
+                        break;
+                    waits = io_waits;
+                }
+
+#if defined(_WIN32)
+                fds.resize(waits.size());
+                for (size_t i = 0; i < waits.size(); i++)
+                {
+                    fds[i].fd = waits[i]->fd;
+                    fds[i].events = waits[i]->events;
+                    fds[i].revents = 0;
+                }
+                if (fds.size() == 0)
+                {
+                    Sleep(ITK_FIBER_POLL_INTERVAL_MS);
+                    continue;
+                }
+                if (WSAPoll(fds.data(), (ULONG)fds.size(), ITK_FIBER_POLL_INTERVAL_MS) <= 0)
+                    continue;
+                const size_t first = 0;
+#else
+                fds.resize(waits.size() + 1);
+                fds[0].fd = wake_pipe[0];
+                fds[0].events = POLLIN;
+                fds[0].revents = 0;
+                for (size_t i = 0; i < waits.size(); i++)
+                {
+                    fds[i + 1].fd = waits[i]->fd;
+                    fds[i + 1].events = waits[i]->events;
+                    fds[i + 1].revents = 0;
+                }
+                if (::poll(fds.data(), (nfds_t)fds.size(), -1) <= 0)
+                    continue;
+                if (fds[0].revents != 0)
+                {
+                    char buffer[64];
+                    while (::read(wake_pipe[0], buffer, sizeof(buffer)) > 0)
+                        ;
+                }
+                const size_t first = 1;
+#endif
+
+                ready.clear();
+                {
+                    Platform::AutoLock autoLock(&io_mutex);
+                    for (size_t i = 0; i < waits.size(); i++)
+                    {
+                        if (fds[first + i].revents == 0)
+                            continue;
+                        // only this thread removes waits: the snapshot is still valid
+                        for (size_t j = 0; j < io_waits.size(); j++)
+                        {
+                            if (io_waits[j] == waits[i])
+                            {
+                                io_waits[j] = io_waits.back();
+                                io_waits.pop_back();
+                                break;
+                            }
+                        }
+                        ready.push_back(waits[i]->fiber);
+                    }
+                }
+                // the IOWait is in the fiber stack, it is not valid after the resume
+                for (auto fiber : ready)
+                    resume(fiber);
+            }
+
+            ready.clear();
+            {
+                Platform::AutoLock autoLock(&io_mutex);
+                for (auto wait : io_waits)
+                {
+                    wait->interrupted = true;
+                    ready.push_back(wait->fiber);
+                }
+                io_waits.clear();
+            }
+            for (auto fiber : ready)
+                resume(fiber);
+        }
+
+        ThreadPool *getBlockingPool()
+        {
+            Platform::AutoLock autoLock(&blocking_mutex);
+            if (blocking_pool == nullptr)
+            {
+                blocking_pool = new ThreadPool(2);
+                owns_blocking_pool = true;
+            }
+            return blocking_pool;
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        FiberExecutor(const FiberExecutor &v) = delete;
+        FiberExecutor &operator=(const FiberExecutor &v) = delete;
+
+        /// \brief Construct the executor
+        ///
+        /// \param pool the pool that runs the fibers
+        /// \param stack_size stack size of each fiber
+        /// \param blocking_pool the pool used by awaitBlocking. If nullptr, a pool with 2 threads is created in the first use.
+        ///
+        FiberExecutor(ThreadPool *pool, uint32_t stack_size = ITK_FIBER_STACK_SIZE, ThreadPool *blocking_pool = nullptr)
+        {
+            this->pool = pool;
+            this->stack_size = stack_size;
+            this->blocking_pool = blocking_pool;
+            owns_blocking_pool = false;
+            active_fibers = 0;
+            io_closing = false;
+
+#if !defined(_WIN32)
+            ITK_ABORT(pipe(wake_pipe) != 0, "Error to create the fiber poller pipe. Message: %s\n", strerror(errno));
+            fcntl(wake_pipe[0], F_SETFL, fcntl(wake_pipe[0], F_GETFL) | O_NONBLOCK);
+            fcntl(wake_pipe[1], F_SETFL, fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+#endif
+
+            io_thread = new Platform::Thread(EventCore::CallbackWrapper(&FiberExecutor::runIO, this));
+            io_thread->start();
+        }
+
+        /// \brief Interrupt the pending socket waits and wait all fibers to finish
+        ///
+        ~FiberExecutor()
+        {
+            {
+                Platform::AutoLock autoLock(&io_mutex);
+                io_closing = true;
+            }
+            wakeIOThread();
+            io_thread->interrupt();
+            io_thread->wait();
+            delete io_thread;
+            io_thread = nullptr;
+
+            waitAll();
+
+#if !defined(_WIN32)
+            ::close(wake_pipe[0]);
+            ::close(wake_pipe[1]);
+#endif
+
+            if (owns_blocking_pool)
+                delete blocking_pool;
+            blocking_pool = nullptr;
+        }
+
+        /// \brief Run the task in a new fiber
+        ///
+        void spawn(const CallbackType &task)
+        {
+            Fiber *fiber = createFiber(task);
+            active_fibers.fetch_add(1);
+            schedule(fiber);
+        }
+
+        /// \brief Block the current thread until all spawned fibers finish
+        ///
+        void waitAll()
+        {
+            ITK_ABORT(isInsideFiber(), "FiberExecutor::waitAll cannot be called from a fiber.\n");
+            while (true)
+            {
+                uint32_t count = active_fibers.load();
+                if (count == 0)
+                    return;
+                Futex::waitRaw(&active_fibers, count);
+            }
+        }
+
+        uint32_t activeFibers() const
+        {
+            return active_fibers.load();
+        }
+
+        // the fiber running in the current thread, nullptr outside a fiber
+        static Fiber *currentFiber()
+        {
+            return currentFiberSlot();
+        }
+
+        static bool isInsideFiber()
+        {
+            return currentFiberSlot() != nullptr;
+        }
+
+        /// \brief Suspend the current fiber until a resume call
+        ///
+        /// If the resume was already called (after the fiber registered itself
+        /// in a wait list), it returns immediately.
+        ///
+        static void suspend()
+        {
+            Fiber *fiber = currentFiber();
+            ITK_ABORT(fiber == nullptr, "FiberExecutor::suspend called outside a fiber.\n");
+            uint32_t expected = Fiber::Running;
+            if (!fiber->state.compare_exchange_strong(expected, (uint32_t)Fiber::Suspending))
+            {
+                // resume already requested
+                fiber->state = Fiber::Running;
+                return;
+            }
+            switchOut(fiber);
+        }
+
+        /// \brief Schedule a suspended fiber in its pool. Can be called from any thread.
+        ///
+        static void resume(Fiber *fiber)
+        {
+            uint32_t state = fiber->state.load();
+            while (true)
+            {
+                if (state == Fiber::ResumePending)
+                    return;
+                if (state == Fiber::Suspended)
+                {
+                    if (fiber->state.compare_exchange_weak(state, (uint32_t)Fiber::Running))
+                    {
+                        fiber->executor->schedule(fiber);
+                        return;
+                    }
+                }
+                else if (fiber->state.compare_exchange_weak(state, (uint32_t)Fiber::ResumePending))
+                    return;
+            }
+        }
+
+        /// \brief Move the current fiber to the end of the pool queue
+        ///
+        static void yield()
+        {
+            Fiber *fiber = currentFiber();
+            if (fiber == nullptr)
+            {
+                Platform::Sleep::yield();
+                return;
+            }
+            fiber->state = Fiber::ResumePending;
+            switchOut(fiber);
+        }
+
+        /// \brief Suspend the current fiber until the native socket is ready
+        ///
+        /// \param events POLLIN and/or POLLOUT
+        /// \return false if the executor is closing
+        ///
+        bool awaitIO(NativeFD fd, short events)
+        {
+            Fiber *fiber = currentFiber();
+            ITK_ABORT(fiber == nullptr, "FiberExecutor::awaitIO called outside a fiber.\n");
+
+            IOWait wait;
+            wait.fd = fd;
+            wait.events = events;
+            wait.fiber = fiber;
+            wait.interrupted = false;
+            {
+                Platform::AutoLock autoLock(&io_mutex);
+                if (io_closing)
+                    return false;
+                io_waits.push_back(&wait);
+            }
+            wakeIOThread();
+            suspend();
+            return !wait.interrupted;
+        }
+
+        /// \brief Run a blocking call in the blocking pool, and suspend the current fiber until it returns
+        ///
+        /// Outside a fiber, the task runs in the current thread.
+        ///
+        /// \code
+        ///
+        /// Platform::ObjectBuffer buffer;
+        /// bool readed;
+        /// executor.awaitBlocking([&](){ readed = queue_ipc.read(&buffer); });
+        /// \endcode
+        ///
+        void awaitBlocking(const CallbackType &task)
+        {
+            Fiber *fiber = currentFiber();
+            if (fiber == nullptr)
+            {
+                task();
+                return;
+            }
+            getBlockingPool()->postTask(CallbackType([&task, fiber]()
+                                                     {
+                                                         task();
+                                                         FiberExecutor::resume(fiber);
+                                                     }));
+            suspend();
+        }
+
+        /// \brief Read size bytes, suspending the fiber while the socket has no data
+        ///
+        /// Returns SOCKET_RESULT_OK only when all size bytes were read. On error or close,
+        /// read_feedback has the number of bytes read before it.
+        ///
+        /// The socket must be in non-blocking mode (setBlocking(false)).
+        ///
+        SocketResult read(SocketTCP *socket, uint8_t *data, uint32_t size, uint32_t *read_feedback = nullptr)
+        {
+            uint32_t current_pos = 0;
+            if (read_feedback != nullptr)
+                *read_feedback = 0;
+            while (true)
+            {
+                uint32_t feedback = 0;
+                SocketResult result = socket->read_buffer(&data[current_pos], size - current_pos, &feedback);
+                current_pos += feedback;
+                if (read_feedback != nullptr)
+                    *read_feedback = current_pos;
+                // read_buffer returns after the first chunk: keep reading until size
+                if (result == SOCKET_RESULT_OK && current_pos < size)
+                    continue;
+                if (result != SOCKET_RESULT_WOULD_BLOCK)
+                    return result;
+                if (!awaitIO(socket->getNativeFD(), POLLIN))
+                    return SOCKET_RESULT_ERROR_INTERRUPTED;
+            }
+        }
+
+        /// \brief Write size bytes, suspending the fiber while the socket send buffer is full
+        ///
+        /// The socket must be in non-blocking mode (setBlocking(false)).
+        ///
+        SocketResult write(SocketTCP *socket, const uint8_t *data, uint32_t size, uint32_t *write_feedback = nullptr)
+        {
+            uint32_t current_pos = 0;
+            if (write_feedback != nullptr)
+                *write_feedback = 0;
+            while (true)
+            {
+                uint32_t feedback = 0;
+                SocketResult result = socket->write_buffer(&data[current_pos], size - current_pos, &feedback);
+                current_pos += feedback;
+                if (write_feedback != nullptr)
+                    *write_feedback = current_pos;
+                if (result != SOCKET_RESULT_WOULD_BLOCK)
+                    return result;
+                if (!awaitIO(socket->getNativeFD(), POLLOUT))
+                    return SOCKET_RESULT_ERROR_INTERRUPTED;
+            }
+        }
+
+        /// \brief Accept a connection, suspending the fiber while there is no pending connection
+        ///
+        /// The accept socket must be created in non-blocking mode.
+        ///
+        SocketResult accept(SocketTCPAccept *server, SocketTCP *result)
+        {
+            while (true)
+            {
+                SocketResult accept_result = server->accept(result);
+                if (accept_result != SOCKET_RESULT_WOULD_BLOCK)
+                    return accept_result;
+                if (!awaitIO(server->getNativeFD(), POLLIN))
+                    return SOCKET_RESULT_ERROR_INTERRUPTED;
+            }
+        }
+    };
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../common.h"
+#include "Core/SmartVector.h"
+#include "FiberExecutor.h"
+
+namespace Platform
+{
+
+    /// \brief Unbounded queue with a dequeue that suspends the fiber instead of the thread.
+    ///
+    /// dequeue must be called from a fiber of a FiberExecutor. enqueue can be called
+    /// from any thread (fiber or not), and resumes the oldest waiting fiber.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::FiberQueue<Message> messages;
+    ///
+    /// executor.spawn([&](){
+    ///     while (true) {
+    ///         Message msg = messages.dequeue();
+    ///         ...
+    ///     }
+    /// });
+    ///
+    /// // any thread
+    /// messages.enqueue(msg);
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T>
+    class FiberQueue
+    {
+        FiberSpinLock spin_lock;
+        SmartVector<T> items;
+        SmartVector<Fiber *> waiters;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        FiberQueue(const FiberQueue &v) = delete;
+        FiberQueue &operator=(const FiberQueue &v) = delete;
+
+        FiberQueue() {}
+
+        void enqueue(const T &v)
+        {
+            spin_lock.lock();
+            items.push_back(v);
+            if (waiters.size() > 0)
+            {
+                Fiber *fiber = waiters.front();
+                waiters.pop_front();
+                spin_lock.unlock();
+                FiberExecutor::resume(fiber);
+                return;
+            }
+            spin_lock.unlock();
+        }
+
+        bool tryDequeue(T *v)
+        {
+            spin_lock.lock();
+            bool result = items.size() > 0;
+            if (result)
+            {
+                *v = std::move(items.front());
+                items.pop_front();
+            }
+            spin_lock.unlock();
+            return result;
+        }
+
+        // suspends the current fiber while the queue is empty
+        T dequeue()
+        {
+            Fiber *fiber = FiberExecutor::currentFiber();
+            ITK_ABORT(fiber == nullptr, "FiberQueue::dequeue called outside a fiber.\n");
+
+            spin_lock.lock();
+            // another fiber can take the item before this one resumes
+            while (items.size() == 0)
+            {
+                waiters.push_back(fiber);
+                spin_lock.unlock();
+                FiberExecutor::suspend();
+                spin_lock.lock();
+            }
+            T result = std::move(items.front());
+            items.pop_front();
+            spin_lock.unlock();
+            return result;
+        }
+
+        size_t size()
+        {
+            spin_lock.lock();
+            size_t result = items.size();
+            spin_lock.unlock();
+            return result;
+        }
+    };
+
+}
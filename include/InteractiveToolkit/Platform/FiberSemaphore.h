@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../common.h"
+#include "Core/SmartVector.h"
+#include "FiberExecutor.h"
+
+namespace Platform
+{
+
+    /// \brief Counting semaphore that suspends the fiber instead of the thread.
+    ///
+    /// acquire must be called from a fiber of a FiberExecutor. release can be called
+    /// from any thread, and hands the count directly to the oldest waiting fiber.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// // at most 8 fibers inside the database section
+    /// Platform::FiberSemaphore database_slots(8);
+    ///
+    /// executor.spawn([&](){
+    ///     database_slots.acquire();
+    ///     ...
+    ///     database_slots.release();
+    /// });
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class FiberSemaphore
+    {
+        FiberSpinLock spin_lock;
+        uint32_t count;
+        SmartVector<Fiber *> waiters;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        FiberSemaphore(const FiberSemaphore &v) = delete;
+        FiberSemaphore &operator=(const FiberSemaphore &v) = delete;
+
+        FiberSemaphore(uint32_t count = 0)
+        {
+            this->count = count;
+        }
+
+        bool tryAcquire()
+        {
+            spin_lock.lock();
+            bool result = count > 0;
+            if (result)
+                count--;
+            spin_lock.unlock();
+            return result;
+        }
+
+        // suspends the current fiber while the count is zero
+        void acquire()
+        {
+            Fiber *fiber = FiberExecutor::currentFiber();
+            ITK_ABORT(fiber == nullptr, "FiberSemaphore::acquire called outside a fiber.\n");
+
+            spin_lock.lock();
+            if (count > 0)
+            {
+                count--;
+                spin_lock.unlock();
+                return;
+            }
+            waiters.push_back(fiber);
+            spin_lock.unlock();
+
+            // the release that removes this fiber from the list transfers the count
+            FiberExecutor::suspend();
+        }
+
+        void release()
+        {
+            spin_lock.lock();
+            if (waiters.size() > 0)
+            {
+                Fiber *fiber = waiters.front();
+                waiters.pop_front();
+                spin_lock.unlock();
+                FiberExecutor::resume(fiber);
+                return;
+            }
+            count++;
+            spin_lock.unlock();
+        }
+    };
+
+}
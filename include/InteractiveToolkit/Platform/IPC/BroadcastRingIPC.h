@@ -0,0 +1,524 @@
+#pragma once
+
+#include "../platform_common.h"
+#include "../Core/ObjectBuffer.h"
+#include "../Core/Futex.h"
+#include "../Thread.h"
+#include "../Sleep.h"
+#include "../../ITKCommon/ITKAbort.h"
+#include "BufferIPC.h"
+#include "QueueIPC.h"
+
+// number of checks before parking in the shared futex
+#ifndef ITK_BROADCAST_RING_SPIN_COUNT
+#define ITK_BROADCAST_RING_SPIN_COUNT 1024
+#endif
+
+namespace Platform
+{
+
+    namespace IPC
+    {
+
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "BroadcastRingIPC requires address-free 64 bit atomics");
+
+        enum class BroadcastRingPolicy : uint32_t
+        {
+            // the writer never waits, a slow reader loses the oldest messages
+            Overwrite = 0,
+            // the writer waits for the slowest reader
+            Block = 1
+        };
+
+        namespace Internal
+        {
+
+            struct BroadcastRingMessageHeader
+            {
+                uint64_t seq;
+                uint32_t size;
+                // bytes to the next message (header + padding + aligned payload)
+                uint32_t total;
+            };
+
+            struct BroadcastRingReaderSlot
+            {
+                alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint64_t> read_pos;
+                std::atomic<uint32_t> active;
+            };
+
+            struct BroadcastRingHeader
+            {
+                uint32_t capacity;
+                uint32_t message_size;
+                uint32_t max_readers;
+                uint32_t policy;
+
+                // producer side
+                alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint64_t> write_pos;
+                // start of the oldest message in the ring, readers behind it lost messages
+                std::atomic<uint64_t> oldest_pos;
+                std::atomic<uint32_t> data_event;
+                std::atomic<uint32_t> readers_waiting;
+                uint64_t next_seq;
+
+                // Block policy: space released by the readers
+                alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> space_event;
+                std::atomic<uint32_t> writer_waiting;
+            };
+
+        }
+
+        /// \brief Shared memory ring with one writer and many readers (broadcast).
+        ///
+        /// The writer writes each message once. Each reader has its own cursor in
+        /// the shared memory, so every reader receives all messages written after it opened the ring.
+        ///
+        /// When a reader is too slow, the policy selects what happens:
+        ///
+        /// - BroadcastRingPolicy::Overwrite: the writer never waits. The oldest messages
+        ///   are overwritten and the slow reader skips them. getLostMessages() counts them.
+        /// - BroadcastRingPolicy::Block: the writer waits for the slowest active reader.
+        ///
+        /// getLagBytes() returns how far a reader is behind the writer.
+        ///
+        /// The readers copy the message and then check that the writer did not
+        /// overwrite it during the copy (as a seqlock). No lock is used after the opening.
+        /// The waiting side spins and then parks in a futex in the shared memory.
+        ///
+        /// All processes must open the ring with the same parameters. A reader process
+        /// that dies without closing the ring keeps its slot (and blocks the writer with the Block policy).
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// // sensor process
+        /// Platform::IPC::BroadcastRingIPC ring("imu", Platform::IPC::QueueIPC_WRITE, 256, 64);
+        /// ring.write((uint8_t*)&sample, sizeof(sample));
+        ///
+        /// // each worker process
+        /// Platform::IPC::BroadcastRingIPC ring("imu", Platform::IPC::QueueIPC_READ, 256, 64);
+        /// Platform::ObjectBuffer msg;
+        /// while (ring.read(&msg)) {
+        ///     if (ring.getLostMessages() > 0) { ... }
+        /// }
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        ///
+        class BroadcastRingIPC
+        {
+            static const uint32_t ALIGN = sizeof(Internal::BroadcastRingMessageHeader);
+
+            BufferIPC bufferIPC;
+
+            Internal::BroadcastRingHeader *header;
+            Internal::BroadcastRingReaderSlot *slots;
+            uint8_t *ring;
+
+            bool writer;
+            BroadcastRingPolicy policy;
+
+            // reader state
+            Internal::BroadcastRingReaderSlot *slot;
+            uint64_t read_pos;
+            uint64_t expected_seq;
+            uint64_t lost_messages;
+
+            // writer state: conservative minimum of the readers positions
+            uint64_t min_read_cache;
+
+            static uint32_t alignSize(uint32_t size)
+            {
+                return (size + ALIGN - 1) & ~(ALIGN - 1);
+            }
+
+            static uint32_t ringCapacity(uint32_t message_count, uint32_t message_size)
+            {
+                // one extra message for the padding that keeps the payloads contiguous
+                uint64_t capacity = (uint64_t)(alignSize(message_size) + ALIGN) * (uint64_t)(message_count + 1);
+                ITK_ABORT(capacity > UINT32_MAX / 2, "BroadcastRingIPC too big.\n");
+                return (uint32_t)capacity;
+            }
+
+            static uint32_t sharedSize(uint32_t message_count, uint32_t message_size, uint32_t max_readers)
+            {
+                return (uint32_t)(sizeof(Internal::BroadcastRingHeader) +
+                                  sizeof(Internal::BroadcastRingReaderSlot) * max_readers +
+                                  ringCapacity(message_count, message_size));
+            }
+
+            // payload offset in the ring of the message at header_index
+            uint32_t payloadIndex(uint32_t header_index, const Internal::BroadcastRingMessageHeader &messageHeader) const
+            {
+                if (messageHeader.total > ALIGN + alignSize(messageHeader.size))
+                    return 0;
+                return (header_index + ALIGN) % header->capacity;
+            }
+
+            uint64_t minReadPos(uint64_t write_pos)
+            {
+                uint64_t result = write_pos;
+                for (uint32_t i = 0; i < header->max_readers; i++)
+                {
+                    if (slots[i].active.load(std::memory_order_acquire) == 0)
+                        continue;
+                    uint64_t pos = slots[i].read_pos.load(std::memory_order_acquire);
+                    if (pos < result)
+                        result = pos;
+                }
+                return result;
+            }
+
+            bool waitSpace(uint64_t write_pos, uint64_t end, bool blocking)
+            {
+                uint32_t capacity = header->capacity;
+                if (end - min_read_cache <= capacity)
+                    return true;
+                min_read_cache = minReadPos(write_pos);
+                if (end - min_read_cache <= capacity)
+                    return true;
+                if (!blocking)
+                    return false;
+
+                for (int i = 0; i < ITK_BROADCAST_RING_SPIN_COUNT; i++)
+                {
+                    Sleep::cpuRelax();
+                    min_read_cache = minReadPos(write_pos);
+                    if (end - min_read_cache <= capacity)
+                        return true;
+                }
+
+                header->writer_waiting.store(1);
+                while (true)
+                {
+                    uint32_t event = header->space_event.load();
+                    min_read_cache = minReadPos(write_pos);
+                    if (end - min_read_cache <= capacity)
+                    {
+                        header->writer_waiting.store(0, std::memory_order_relaxed);
+                        return true;
+                    }
+                    if (Futex::waitInterruptible(&header->space_event, event, UINT32_MAX, false, true) == FutexWaitResult::Interrupted)
+                    {
+                        header->writer_waiting.store(0, std::memory_order_relaxed);
+                        min_read_cache = minReadPos(write_pos);
+                        return end - min_read_cache <= capacity;
+                    }
+                }
+            }
+
+            bool waitData(bool blocking, bool *_signaled)
+            {
+                if (header->write_pos.load(std::memory_order_acquire) != read_pos)
+                    return true;
+                if (!blocking)
+                    return false;
+
+                for (int i = 0; i < ITK_BROADCAST_RING_SPIN_COUNT; i++)
+                {
+                    Sleep::cpuRelax();
+                    if (header->write_pos.load(std::memory_order_acquire) != read_pos)
+                        return true;
+                }
+
+                header->readers_waiting.fetch_add(1);
+                while (true)
+                {
+                    uint32_t event = header->data_event.load();
+                    if (header->write_pos.load() != read_pos)
+                        break;
+                    if (Futex::waitInterruptible(&header->data_event, event, UINT32_MAX, false, true) == FutexWaitResult::Interrupted &&
+                        header->write_pos.load() == read_pos)
+                    {
+                        header->readers_waiting.fetch_sub(1);
+                        if (_signaled != nullptr)
+                            *_signaled = true;
+                        return false;
+                    }
+                }
+                header->readers_waiting.fetch_sub(1);
+                return true;
+            }
+
+            void publishReadPos()
+            {
+                slot->read_pos.store(read_pos, std::memory_order_release);
+                if (policy != BroadcastRingPolicy::Block)
+                    return;
+                // pairs with the writer_waiting store before the writer last check
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (header->writer_waiting.load(std::memory_order_relaxed))
+                {
+                    header->space_event.fetch_add(1, std::memory_order_relaxed);
+                    Futex::wakeOne(&header->space_event, true);
+                }
+            }
+
+            void openReader()
+            {
+                for (uint32_t i = 0; i < header->max_readers; i++)
+                {
+                    uint32_t expected = 0;
+                    if (slots[i].active.compare_exchange_strong(expected, 1))
+                    {
+                        slot = &slots[i];
+                        // starts at the next message
+                        read_pos = header->write_pos.load();
+                        publishReadPos();
+                        return;
+                    }
+                }
+                ITK_ABORT(true, "BroadcastRingIPC has no free reader slot.\n");
+            }
+
+        public:
+            // deleted copy constructor and assign operator, to avoid copy...
+            BroadcastRingIPC(const BroadcastRingIPC &v) = delete;
+            BroadcastRingIPC &operator=(const BroadcastRingIPC &v) = delete;
+
+#if defined(__linux__) || defined(__APPLE__)
+            // unlink all resources
+            static void force_shm_unlink(const std::string &name)
+            {
+                BufferIPC::force_shm_unlink(name + std::string("_abr"));
+            }
+#endif
+
+            /// \brief Open the ring
+            ///
+            /// \param name global name of the ring
+            /// \param mode QueueIPC_WRITE (the only writer) and/or QueueIPC_READ (one reader slot)
+            /// \param message_count number of messages of message_size the ring holds
+            /// \param message_size maximum payload size
+            /// \param policy what happens when a reader is too slow
+            /// \param max_readers number of reader slots
+            ///
+            BroadcastRingIPC(const char *name = "default",
+                             uint32_t mode = QueueIPC_READ,
+                             uint32_t message_count = 64,
+                             uint32_t message_size = 1024,
+                             BroadcastRingPolicy policy = BroadcastRingPolicy::Overwrite,
+                             uint32_t max_readers = 16) : bufferIPC((std::string(name) + std::string("_abr")).c_str(),
+                                                                    sharedSize(message_count, message_size, max_readers))
+            {
+                ITK_ABORT((mode & (QueueIPC_READ | QueueIPC_WRITE)) == 0, "Queue opening mode not specified.\n");
+
+                header = (Internal::BroadcastRingHeader *)bufferIPC.data;
+                slots = (Internal::BroadcastRingReaderSlot *)&bufferIPC.data[sizeof(Internal::BroadcastRingHeader)];
+                ring = &bufferIPC.data[sizeof(Internal::BroadcastRingHeader) + sizeof(Internal::BroadcastRingReaderSlot) * max_readers];
+
+                if (bufferIPC.isFirstProcess())
+                {
+                    memset(bufferIPC.data, 0, bufferIPC.size);
+                    header->capacity = ringCapacity(message_count, message_size);
+                    header->message_size = message_size;
+                    header->max_readers = max_readers;
+                    header->policy = (uint32_t)policy;
+                    header->write_pos = 0;
+                    header->oldest_pos = 0;
+                    header->data_event = 0;
+                    header->readers_waiting = 0;
+                    header->next_seq = 0;
+                    header->space_event = 0;
+                    header->writer_waiting = 0;
+                    for (uint32_t i = 0; i < max_readers; i++)
+                    {
+                        slots[i].read_pos = 0;
+                        slots[i].active = 0;
+                    }
+                }
+                else
+                {
+                    ITK_ABORT(header->capacity != ringCapacity(message_count, message_size) ||
+                                  header->message_size != message_size ||
+                                  header->max_readers != max_readers ||
+                                  header->policy != (uint32_t)policy,
+                              "BroadcastRingIPC opened with different parameters.\n");
+                }
+
+                this->policy = policy;
+                writer = (mode & QueueIPC_WRITE) != 0;
+                slot = nullptr;
+                read_pos = 0;
+                expected_seq = UINT64_MAX;
+                lost_messages = 0;
+                min_read_cache = 0;
+
+                if (mode & QueueIPC_READ)
+                    openReader();
+
+                bufferIPC.finishInitialization();
+            }
+
+            ~BroadcastRingIPC()
+            {
+                if (slot != nullptr)
+                {
+                    slot->active.store(0);
+                    // the writer may be waiting this reader
+                    if (header->writer_waiting.load())
+                    {
+                        header->space_event.fetch_add(1);
+                        Futex::wakeOne(&header->space_event, true);
+                    }
+                    slot = nullptr;
+                }
+            }
+
+            /// \brief Write one message to all readers
+            ///
+            /// \param blocking with the Block policy, wait the slowest reader
+            /// \return false if there is no space (Block policy, not blocking or interrupted)
+            ///
+            bool write(const uint8_t *data, uint32_t size, bool blocking = true)
+            {
+                ITK_ABORT(!writer, "BroadcastRingIPC write without QueueIPC_WRITE.\n");
+                ITK_ABORT(size > header->message_size, "Buffer too big for this ring.\n");
+
+                uint32_t capacity = header->capacity;
+                uint64_t write_pos = header->write_pos.load(std::memory_order_relaxed);
+
+                uint32_t header_index = (uint32_t)(write_pos % capacity);
+                uint32_t payload_index = (header_index + ALIGN) % capacity;
+                uint32_t aligned_size = alignSize(size);
+                uint32_t remaining_space = capacity - payload_index;
+                uint32_t padding = (remaining_space < aligned_size) ? remaining_space : 0;
+                if (padding > 0)
+                    payload_index = 0;
+
+                Internal::BroadcastRingMessageHeader messageHeader;
+                messageHeader.seq = header->next_seq;
+                messageHeader.size = size;
+                messageHeader.total = ALIGN + padding + aligned_size;
+
+                uint64_t end = write_pos + messageHeader.total;
+
+                if (policy == BroadcastRingPolicy::Block && !waitSpace(write_pos, end, blocking))
+                    return false;
+
+                // drop the messages that will be overwritten
+                uint64_t oldest_pos = header->oldest_pos.load(std::memory_order_relaxed);
+                if (end - oldest_pos > capacity)
+                {
+                    while (end - oldest_pos > capacity)
+                    {
+                        Internal::BroadcastRingMessageHeader old;
+                        memcpy(&old, &ring[oldest_pos % capacity], sizeof(old));
+                        oldest_pos += old.total;
+                    }
+                    header->oldest_pos.store(oldest_pos, std::memory_order_relaxed);
+                    // the readers check oldest_pos after the copy:
+                    // it must be visible before the new bytes
+                    std::atomic_thread_fence(std::memory_order_release);
+                }
+
+                memcpy(&ring[header_index], &messageHeader, sizeof(messageHeader));
+                if (size > 0)
+                    memcpy(&ring[payload_index], data, size);
+                header->next_seq++;
+
+                header->write_pos.store(end, std::memory_order_release);
+
+                // pairs with the readers_waiting increment before the readers last check
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (header->readers_waiting.load(std::memory_order_relaxed) > 0)
+                {
+                    header->data_event.fetch_add(1, std::memory_order_relaxed);
+                    Futex::wakeAll(&header->data_event, true);
+                }
+
+                return true;
+            }
+
+            bool write(const ObjectBuffer &inputBuffer, bool blocking = true)
+            {
+                return write(inputBuffer.data, (uint32_t)inputBuffer.size, blocking);
+            }
+
+            /// \brief Read the next message of this reader
+            ///
+            /// With the Overwrite policy, the messages overwritten before this reader
+            /// could copy them are skipped and counted in getLostMessages().
+            ///
+            /// \param blocking wait for a new message
+            /// \return false if there is no message (not blocking or interrupted)
+            ///
+            bool read(ObjectBuffer *outputBuffer, bool blocking = true, bool *_signaled = nullptr)
+            {
+                if (_signaled != nullptr)
+                    *_signaled = false;
+                ITK_ABORT(slot == nullptr, "BroadcastRingIPC read without QueueIPC_READ.\n");
+
+                uint32_t capacity = header->capacity;
+                while (true)
+                {
+                    if (!waitData(blocking, _signaled))
+                        return false;
+
+                    // lagged: jump to the oldest message (the seq gap counts the lost ones)
+                    uint64_t oldest_pos = header->oldest_pos.load(std::memory_order_acquire);
+                    if (read_pos < oldest_pos)
+                        read_pos = oldest_pos;
+
+                    uint32_t header_index = (uint32_t)(read_pos % capacity);
+                    Internal::BroadcastRingMessageHeader messageHeader;
+                    memcpy(&messageHeader, &ring[header_index], sizeof(messageHeader));
+
+                    // the header can be garbage when the writer overwrote it
+                    bool valid = messageHeader.size <= header->message_size &&
+                                 messageHeader.total >= ALIGN + alignSize(messageHeader.size) &&
+                                 messageHeader.total <= capacity;
+                    if (valid)
+                    {
+                        outputBuffer->setSize(messageHeader.size);
+                        if (messageHeader.size > 0)
+                            memcpy(outputBuffer->data, &ring[payloadIndex(header_index, messageHeader)], messageHeader.size);
+                    }
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (read_pos < header->oldest_pos.load(std::memory_order_relaxed))
+                        continue; // overwritten during the copy
+
+                    ITK_ABORT(!valid, "BroadcastRingIPC invalid message header.\n");
+
+                    read_pos += messageHeader.total;
+                    publishReadPos();
+
+                    if (expected_seq != UINT64_MAX && messageHeader.seq > expected_seq)
+                        lost_messages += messageHeader.seq - expected_seq;
+                    expected_seq = messageHeader.seq + 1;
+
+                    return true;
+                }
+            }
+
+            // reader: number of messages skipped because they were overwritten
+            uint64_t getLostMessages() const
+            {
+                return lost_messages;
+            }
+
+            // reader: bytes written and not read yet (compare with getCapacity())
+            uint64_t getLagBytes() const
+            {
+                if (slot == nullptr)
+                    return 0;
+                return header->write_pos.load(std::memory_order_acquire) - read_pos;
+            }
+
+            uint32_t getCapacity() const
+            {
+                return header->capacity;
+            }
+
+            BroadcastRingPolicy getPolicy() const
+            {
+                return policy;
+            }
+        };
+
+    }
+
+}
@@ -3,6 +3,12 @@
 #include "QueueIPC.h"
 #include "SemaphoreIPC.h"
 #include "ConditionIPC.h"
+#include "../Core/Futex.h"
+
+// number of checks before parking in the shared futex (LowLatencyQueueIPC_SPSC)
+#ifndef ITK_LOW_LATENCY_QUEUE_SPIN_COUNT
+#define ITK_LOW_LATENCY_QUEUE_SPIN_COUNT 1024
+#endif
 
 namespace Platform
 {
@@ -10,11 +16,81 @@ namespace Platform
     namespace IPC
     {
 
+        // open flag: one writer process/thread and one reader process/thread, no cross-process lock
+        const uint32_t LowLatencyQueueIPC_SPSC = 1 << 2;
+
+        static_assert(ATOMIC_INT_LOCK_FREE == 2, "LowLatencyQueueIPC_SPSC requires address-free 32 bit atomics");
+
+        // shared header of the LowLatencyQueueIPC
+        struct LowLatencyQueueHeader
+        {
+            QueueHeader queue;
+            // 1 when created with LowLatencyQueueIPC_SPSC
+            uint32_t spsc;
+
+            // SPSC mode: byte positions in the range [0, 2 * capacity)
+            // consumer side
+            alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> head;
+            std::atomic<uint32_t> consumer_parked;
+            // producer side
+            alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> tail;
+            std::atomic<uint32_t> producer_parked;
+        };
+
+        /// \brief Shared memory queue of variable size messages between processes.
+        ///
+        /// By default the ring is protected by a named semaphore, so any number of
+        /// processes can read and write.
+        ///
+        /// With the LowLatencyQueueIPC_SPSC open flag, only one writer and one reader
+        /// can use the queue. The shared header keeps the read (head) and write (tail)
+        /// positions in separated cache lines. A message is copied to the ring and
+        /// published with a release store of the tail, the reader acquires it and
+        /// releases the space with a store of the head. There is no cross-process lock
+        /// and no semaphore on the message path.
+        ///
+        /// In SPSC mode, a blocking reader (or a writer waiting for space) spins and then parks
+        /// in a futex in the shared header. The other side calls the kernel only when
+        /// there is a parked thread. All processes must open the queue with the same flag.
+        ///
+        /// The zero-copy API (reserve/commit and peek/release) works like in the QueueIPC.
+        /// In SPSC mode it does not lock: the writer fills the reserved span while the reader
+        /// processes the peeked one.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// // writer process
+        /// Platform::IPC::LowLatencyQueueIPC queue("frames",
+        ///     Platform::IPC::QueueIPC_WRITE | Platform::IPC::LowLatencyQueueIPC_SPSC, 64, 4096);
+        /// queue.write(data, size);
+        ///
+        /// // reader process
+        /// Platform::IPC::LowLatencyQueueIPC queue("frames",
+        ///     Platform::IPC::QueueIPC_READ | Platform::IPC::LowLatencyQueueIPC_SPSC, 64, 4096);
+        /// Platform::ObjectBuffer msg;
+        /// if (queue.read(&msg)) { ... }
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        ///
         class LowLatencyQueueIPC : public EventCore::HandleCallback
         {
 
             bool blocking_on_read;
 
+            // SPSC mode state (process local caches of the other side position)
+            bool spsc;
+            uint32_t head_cache;
+            uint32_t tail_cache;
+
+            // zero-copy state, valid from reserve to commit and from peek to release
+            uint32_t reserved_size;
+            uint32_t reserved_padding;
+            // locked mode: payload size, SPSC mode: whole message size
+            uint32_t release_size;
+
             std::string name;
 
             std::string header_name;
@@ -129,6 +205,447 @@ namespace Platform
                 // printf("\n    Queue reader:%u total:%u\n", size,queue_header_ptr->size );
             }
 
+            void skip_write(uint32_t size)
+            {
+                ITK_ABORT(size > (queue_header_ptr->capacity - queue_header_ptr->size), "Error to write more than the buffer size\n.");
+                queue_header_ptr->write_pos = (queue_header_ptr->write_pos + size) % queue_header_ptr->capacity;
+                queue_header_ptr->size += size;
+            }
+
+            void skip_read(uint32_t size)
+            {
+                ITK_ABORT(size > queue_header_ptr->size, "Error to read more than the buffer size\n.");
+                queue_header_ptr->read_pos = (queue_header_ptr->read_pos + size) % queue_header_ptr->capacity;
+                queue_header_ptr->size -= size;
+            }
+
+            // locked: space used by a message, with the padding that keeps the payload contiguous
+            uint32_t write_request_size(uint32_t size, uint32_t *padding)
+            {
+                // rewind the empty ring: a message up to the capacity never needs padding
+                if (queue_header_ptr->size == 0)
+                {
+                    queue_header_ptr->write_pos = 0;
+                    queue_header_ptr->read_pos = 0;
+                }
+                uint32_t payload_pos = (queue_header_ptr->write_pos + sizeof(BufferHeader)) % queue_header_ptr->capacity;
+                uint32_t remaining_space = queue_header_ptr->capacity - payload_pos;
+                *padding = (remaining_space < size) ? remaining_space : 0;
+                return sizeof(BufferHeader) + *padding + size;
+            }
+
+            // returns locked, or nullptr
+            uint8_t *reserve_payload(uint32_t size, bool blocking, bool ignore_first_lock)
+            {
+                shm_mutex.lock();
+                if (queue_semaphore == nullptr)
+                {
+                    shm_mutex.unlock();
+                    return nullptr;
+                }
+
+                ITK_ABORT(size + sizeof(BufferHeader) > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
+
+                uint32_t padding;
+                if (!ignore_first_lock)
+                {
+                    if (can_write_cond_mutex != nullptr)
+                    {
+                        //printf("trying to lock mutex cond\n");
+                        AutoLockSemaphoreIPC ipc_lock(can_write_cond_mutex);
+                        if (ipc_lock.signaled) {
+                            shm_mutex.unlock();
+                            return nullptr;
+                        }
+
+                        // use condition
+                        lock();
+                        uint32_t size_request = write_request_size(size, &padding);
+                        uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
+                        while (size_request > remaining_space)
+                        {
+                            unlock();
+                            shm_mutex.unlock();
+
+                            if (!blocking)
+                                return nullptr;
+
+                            //printf("wait cond\n");
+                            bool signaled = false;
+                            can_write_cond->wait(can_write_cond_mutex, &signaled);
+                            if (signaled) {
+                                ipc_lock.cancelAutoRelease();
+                                return nullptr;
+                            }
+
+                            shm_mutex.lock();
+                            if (queue_semaphore == nullptr)
+                            {
+                                shm_mutex.unlock();
+                                return nullptr;
+                            }
+                            lock();
+                            size_request = write_request_size(size, &padding);
+                            remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
+                        }
+                    }
+                    else
+                    {
+
+                        lock();
+                        uint32_t size_request = write_request_size(size, &padding);
+                        uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
+                        while (size_request > remaining_space)
+                        {
+                            unlock();
+                            shm_mutex.unlock();
+
+                            if (!blocking || Platform::Thread::isCurrentThreadInterrupted())
+                                return nullptr;
+
+                            // maybe the yield give us a better result...but increases the CPU usage
+                            // Platform::Sleep::millis(1);
+                            Platform::Sleep::yield();
+
+                            shm_mutex.lock();
+                            if (queue_semaphore == nullptr)
+                            {
+                                shm_mutex.unlock();
+                                return nullptr;
+                            }
+                            lock();
+                            size_request = write_request_size(size, &padding);
+                            remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
+                        }
+                    }
+                }
+                else
+                    write_request_size(size, &padding);
+
+                reserved_size = size;
+                reserved_padding = padding;
+
+                uint32_t payload_pos = (queue_header_ptr->write_pos + sizeof(BufferHeader) + padding) % queue_header_ptr->capacity;
+                return &queue_buffer_ptr[payload_pos];
+            }
+
+            // returns locked, or nullptr
+            const uint8_t *peek_payload(uint32_t *size, bool *_signaled)
+            {
+                if (_signaled != nullptr)
+                    *_signaled = false;
+
+                if (blocking_on_read)
+                {
+                    bool signaled = !semaphore_ipc->blockingAcquire();
+                    if (signaled){
+                        if (_signaled != nullptr)
+                            *_signaled = signaled;
+                        return nullptr;
+                    }
+                }
+
+                shm_mutex.lock();
+                if (queue_semaphore == nullptr)
+                {
+                    if (blocking_on_read)
+                        semaphore_ipc->release();
+                    shm_mutex.unlock();
+                    return nullptr;
+                }
+
+                lock();
+
+                if (queue_header_ptr->size == 0)
+                {
+                    unlock();
+                    shm_mutex.unlock();
+
+                    // printf("ERROR: Trying to read element from an empty queue.\n");
+                    return nullptr;
+                }
+
+                BufferHeader bufferHeader;
+                read_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
+                if (bufferHeader.size & BufferHeader_WRAP)
+                {
+                    bufferHeader.size &= ~BufferHeader_WRAP;
+                    skip_read(queue_header_ptr->capacity - queue_header_ptr->read_pos);
+                }
+
+                release_size = bufferHeader.size;
+                *size = bufferHeader.size;
+                return &queue_buffer_ptr[queue_header_ptr->read_pos];
+            }
+
+            LowLatencyQueueHeader *sharedHeader()
+            {
+                return (LowLatencyQueueHeader *)queue_header_ptr;
+            }
+
+            uint32_t spscAdvance(uint32_t pos, uint32_t size) const
+            {
+                uint32_t limit = queue_header_ptr->capacity << 1;
+                pos += size;
+                if (pos >= limit)
+                    pos -= limit;
+                return pos;
+            }
+
+            uint32_t spscIndex(uint32_t pos) const
+            {
+                uint32_t capacity = queue_header_ptr->capacity;
+                return (pos >= capacity) ? pos - capacity : pos;
+            }
+
+            // space used by a message written at the current tail
+            uint32_t spscRequestSize(uint32_t size, uint32_t *padding)
+            {
+                uint32_t t = sharedHeader()->tail.load(std::memory_order_relaxed);
+                uint32_t payload_index = spscIndex(spscAdvance(t, sizeof(BufferHeader)));
+                uint32_t remaining_space = queue_header_ptr->capacity - payload_index;
+                *padding = (remaining_space < size) ? remaining_space : 0;
+                return sizeof(BufferHeader) + *padding + size;
+            }
+
+            // bytes between two positions
+            uint32_t spscDistance(uint32_t from, uint32_t to) const
+            {
+                if (to >= from)
+                    return to - from;
+                return to + (queue_header_ptr->capacity << 1) - from;
+            }
+
+            void spscCopyIn(uint32_t pos, const uint8_t *data, uint32_t size)
+            {
+                uint32_t capacity = queue_header_ptr->capacity;
+                uint32_t index = spscIndex(pos);
+                uint32_t remaining_space = capacity - index;
+                if (remaining_space < size)
+                {
+                    // two memcpy
+                    memcpy(&queue_buffer_ptr[index], data, remaining_space);
+                    memcpy(&queue_buffer_ptr[0], &data[remaining_space], size - remaining_space);
+                }
+                else
+                {
+                    // one memcpy
+                    memcpy(&queue_buffer_ptr[index], data, size);
+                }
+            }
+
+            void spscCopyOut(uint32_t pos, uint8_t *data, uint32_t size)
+            {
+                uint32_t capacity = queue_header_ptr->capacity;
+                uint32_t index = spscIndex(pos);
+                uint32_t remaining_space = capacity - index;
+                if (remaining_space < size)
+                {
+                    // two memcpy
+                    memcpy(data, &queue_buffer_ptr[index], remaining_space);
+                    memcpy(&data[remaining_space], &queue_buffer_ptr[0], size - remaining_space);
+                }
+                else
+                {
+                    // one memcpy
+                    memcpy(data, &queue_buffer_ptr[index], size);
+                }
+            }
+
+            // producer: free bytes, reads the shared head only when the cached value is not enough
+            uint32_t spscFreeSpace(uint32_t size_request)
+            {
+                LowLatencyQueueHeader *header = sharedHeader();
+                uint32_t t = header->tail.load(std::memory_order_relaxed);
+                uint32_t free_space = queue_header_ptr->capacity - spscDistance(head_cache, t);
+                if (free_space < size_request)
+                {
+                    head_cache = header->head.load(std::memory_order_acquire);
+                    free_space = queue_header_ptr->capacity - spscDistance(head_cache, t);
+                }
+                return free_space;
+            }
+
+            // consumer: filled bytes, reads the shared tail only when the cached value says empty
+            uint32_t spscFilled()
+            {
+                LowLatencyQueueHeader *header = sharedHeader();
+                uint32_t h = header->head.load(std::memory_order_relaxed);
+                uint32_t filled = spscDistance(h, tail_cache);
+                if (filled == 0)
+                {
+                    tail_cache = header->tail.load(std::memory_order_acquire);
+                    filled = spscDistance(h, tail_cache);
+                }
+                return filled;
+            }
+
+            void spscPublishTail(uint32_t t)
+            {
+                LowLatencyQueueHeader *header = sharedHeader();
+                header->tail.store(t, std::memory_order_release);
+                // pairs with the consumer_parked store before the consumer last check
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (header->consumer_parked.load(std::memory_order_relaxed))
+                    Futex::wakeOne(&header->tail, true);
+            }
+
+            void spscPublishHead(uint32_t h)
+            {
+                LowLatencyQueueHeader *header = sharedHeader();
+                header->head.store(h, std::memory_order_release);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (header->producer_parked.load(std::memory_order_relaxed))
+                    Futex::wakeOne(&header->head, true);
+            }
+
+            bool spscWaitSpace(uint32_t size_request, bool blocking)
+            {
+                if (spscFreeSpace(size_request) >= size_request)
+                    return true;
+                if (!blocking)
+                    return false;
+
+                for (int i = 0; i < ITK_LOW_LATENCY_QUEUE_SPIN_COUNT; i++)
+                {
+                    Sleep::cpuRelax();
+                    if (spscFreeSpace(size_request) >= size_request)
+                        return true;
+                }
+
+                LowLatencyQueueHeader *header = sharedHeader();
+                while (true)
+                {
+                    header->producer_parked.store(1);
+                    uint32_t h = header->head.load();
+                    head_cache = h;
+                    if (spscFreeSpace(size_request) >= size_request)
+                    {
+                        header->producer_parked.store(0, std::memory_order_relaxed);
+                        return true;
+                    }
+                    FutexWaitResult result = Futex::waitInterruptible(&header->head, h, UINT32_MAX, false, true);
+                    header->producer_parked.store(0, std::memory_order_relaxed);
+                    if (result == FutexWaitResult::Interrupted)
+                        return spscFreeSpace(size_request) >= size_request;
+                }
+            }
+
+            bool spscWaitData(bool *_signaled)
+            {
+                if (spscFilled() > 0)
+                    return true;
+                if (!blocking_on_read)
+                    return false;
+
+                for (int i = 0; i < ITK_LOW_LATENCY_QUEUE_SPIN_COUNT; i++)
+                {
+                    Sleep::cpuRelax();
+                    if (spscFilled() > 0)
+                        return true;
+                }
+
+                LowLatencyQueueHeader *header = sharedHeader();
+                while (true)
+                {
+                    header->consumer_parked.store(1);
+                    uint32_t t = header->tail.load();
+                    tail_cache = t;
+                    if (spscFilled() > 0)
+                    {
+                        header->consumer_parked.store(0, std::memory_order_relaxed);
+                        return true;
+                    }
+                    FutexWaitResult result = Futex::waitInterruptible(&header->tail, t, UINT32_MAX, false, true);
+                    header->consumer_parked.store(0, std::memory_order_relaxed);
+                    if (result == FutexWaitResult::Interrupted)
+                    {
+                        if (spscFilled() > 0)
+                            return true;
+                        if (_signaled != nullptr)
+                            *_signaled = true;
+                        return false;
+                    }
+                }
+            }
+
+            void spscCheckSize(uint32_t size)
+            {
+                // an empty ring must fit the message with the worst padding
+                ITK_ABORT((uint64_t)size * 2 + sizeof(BufferHeader) > (uint64_t)queue_header_ptr->capacity, "Buffer too big for this queue.\n");
+            }
+
+            uint8_t *spscReserve(uint32_t size, bool blocking, bool ignore_first_lock)
+            {
+                if (queue_buffer_handle == BUFFER_HANDLE_nullptr)
+                    return nullptr;
+
+                spscCheckSize(size);
+
+                uint32_t padding;
+                uint32_t size_request = spscRequestSize(size, &padding);
+
+                // ignore_first_lock: the space was checked by writeHasEnoughSpace,
+                // in SPSC mode it can only grow
+                if (!ignore_first_lock && !spscWaitSpace(size_request, blocking))
+                    return nullptr;
+
+                reserved_size = size;
+                reserved_padding = padding;
+
+                if (padding > 0)
+                    return &queue_buffer_ptr[0];
+                uint32_t t = sharedHeader()->tail.load(std::memory_order_relaxed);
+                return &queue_buffer_ptr[spscIndex(spscAdvance(t, sizeof(BufferHeader)))];
+            }
+
+            void spscCommit(uint32_t size)
+            {
+                BufferHeader bufferHeader;
+                bufferHeader.size = size;
+                if (reserved_padding > 0)
+                    bufferHeader.size |= BufferHeader_WRAP;
+
+                uint32_t t = sharedHeader()->tail.load(std::memory_order_relaxed);
+                spscCopyIn(t, (uint8_t *)&bufferHeader, sizeof(BufferHeader));
+                spscPublishTail(spscAdvance(t, sizeof(BufferHeader) + reserved_padding + size));
+            }
+
+            const uint8_t *spscPeek(uint32_t *size, bool *_signaled)
+            {
+                if (_signaled != nullptr)
+                    *_signaled = false;
+                if (queue_buffer_handle == BUFFER_HANDLE_nullptr)
+                    return nullptr;
+
+                if (!spscWaitData(_signaled))
+                    return nullptr;
+
+                // the tail is published after the whole message
+                uint32_t h = sharedHeader()->head.load(std::memory_order_relaxed);
+                BufferHeader bufferHeader;
+                spscCopyOut(h, (uint8_t *)&bufferHeader, sizeof(BufferHeader));
+
+                uint32_t payload_index = spscIndex(spscAdvance(h, sizeof(BufferHeader)));
+                uint32_t padding = 0;
+                if (bufferHeader.size & BufferHeader_WRAP)
+                {
+                    bufferHeader.size &= ~BufferHeader_WRAP;
+                    padding = queue_header_ptr->capacity - payload_index;
+                    payload_index = 0;
+                }
+
+                release_size = sizeof(BufferHeader) + padding + bufferHeader.size;
+                *size = bufferHeader.size;
+                return &queue_buffer_ptr[payload_index];
+            }
+
+            void spscRelease()
+            {
+                uint32_t h = sharedHeader()->head.load(std::memory_order_relaxed);
+                spscPublishHead(spscAdvance(h, release_size));
+            }
+
             void releaseAll(bool release_semaphore_ipc)
             {
                 Platform::AutoLock autoLock(&shm_mutex);
@@ -174,7 +691,7 @@ namespace Platform
                     CloseHandle(queue_header_handle);
 #elif defined(__linux__) || defined(__APPLE__)
                     if (queue_header_ptr != MAP_FAILED)
-                        munmap(queue_header_ptr, sizeof(Platform::IPC::QueueHeader));
+                        munmap(queue_header_ptr, sizeof(LowLatencyQueueHeader));
                     close(queue_header_handle); // close FD
                                                 // shm_unlink(header_name.c_str());
 #endif
@@ -313,7 +830,17 @@ namespace Platform
                 can_write_cond = nullptr;
                 can_write_cond_mutex = nullptr;
 
-                if (use_write_contition_variable)
+                spsc = (mode & LowLatencyQueueIPC_SPSC) != 0;
+                mode &= ~LowLatencyQueueIPC_SPSC;
+                head_cache = 0;
+                tail_cache = 0;
+
+                reserved_size = UINT32_MAX;
+                reserved_padding = 0;
+                release_size = UINT32_MAX;
+
+                // the SPSC mode waits for space in the shared futex
+                if (use_write_contition_variable && !spsc)
                 {
                     can_write_cond = new ConditionIPC(name);
                     can_write_cond_mutex = new SemaphoreIPC(std::string(name) + std::string("_cv_wc"), 1, can_write_cond->bufferIPC()->isFirstProcess());
@@ -394,13 +921,13 @@ namespace Platform
 
 #if defined(_WIN32)
                 // open the header memory section
-                queue_header_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Platform::IPC::QueueHeader), header_name.c_str());
+                queue_header_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(LowLatencyQueueHeader), header_name.c_str());
                 if (queue_header_handle == 0)
                 {
                     unlock(true);
                     ITK_ABORT(true, "Error to create the header IPC queue.\n");
                 }
-                queue_header_ptr = (Platform::IPC::QueueHeader *)MapViewOfFile(queue_header_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Platform::IPC::QueueHeader));
+                queue_header_ptr = (Platform::IPC::QueueHeader *)MapViewOfFile(queue_header_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(LowLatencyQueueHeader));
                 if (queue_header_ptr == 0)
                 {
                     unlock(true);
@@ -424,14 +951,14 @@ namespace Platform
                 ITK_ABORT(rc != 0, "Error to stat the file descriptor. Error code: %s\n", strerror(errno));
                 if (_stat.st_size == 0)
                 {
-                    rc = ftruncate(queue_header_handle, sizeof(Platform::IPC::QueueHeader));
-                    // fallocate(queue_header_handle, 0, 0, sizeof(Platform::IPC::QueueHeader));
+                    rc = ftruncate(queue_header_handle, sizeof(LowLatencyQueueHeader));
+                    // fallocate(queue_header_handle, 0, 0, sizeof(LowLatencyQueueHeader));
                     ITK_ABORT(rc != 0, "Error to truncate buffer. Error code: %s\n", strerror(errno));
                 }
 
                 queue_header_ptr = (Platform::IPC::QueueHeader *)mmap(
                     nullptr,
-                    sizeof(Platform::IPC::QueueHeader),
+                    sizeof(LowLatencyQueueHeader),
                     PROT_READ | PROT_WRITE,
                     MAP_SHARED,
                     queue_header_handle,
@@ -448,7 +975,16 @@ namespace Platform
                 {
 
                     printf("[LowLatencyQueueIPC] Not First Opened - Retrieving Shared Memory Information...\n");
-                    semaphore_ipc = new SemaphoreIPC(semaphore_count_name, 0, false, false);
+                    if ((sharedHeader()->spsc != 0) != spsc)
+                    {
+                        unlock(true);
+                        ITK_ABORT(true, "LowLatencyQueueIPC opened with a different LowLatencyQueueIPC_SPSC flag.\n");
+                    }
+                    // the ring may be in use: start from the shared positions
+                    head_cache = sharedHeader()->head.load(std::memory_order_acquire);
+                    tail_cache = sharedHeader()->tail.load(std::memory_order_acquire);
+                    if (!spsc)
+                        semaphore_ipc = new SemaphoreIPC(semaphore_count_name, 0, false, false);
 
 #if !defined(_WIN32)
                     // initialize semaphore
@@ -472,7 +1008,8 @@ namespace Platform
                 {
                     printf("[LowLatencyQueueIPC] First Opened - Creating Shared Memory...\n");
 
-                    semaphore_ipc = new SemaphoreIPC(semaphore_count_name, 0, true, false);
+                    if (!spsc)
+                        semaphore_ipc = new SemaphoreIPC(semaphore_count_name, 0, true, false);
 
 #if !defined(_WIN32)
                     // truncate semaphore before initialize it
@@ -500,8 +1037,16 @@ namespace Platform
 
                     queue_header_ptr->queue_size = queue_size_;
                     queue_header_ptr->buffer_size = buffer_size_ + sizeof(BufferHeader);
-                    queue_header_ptr->capacity = queue_header_ptr->buffer_size * queue_header_ptr->queue_size;
+                    // one extra buffer for the padding that keeps the payloads contiguous
+                    queue_header_ptr->capacity = queue_header_ptr->buffer_size * (queue_header_ptr->queue_size + 1);
                     queue_header_ptr->size = 0;
+
+                    LowLatencyQueueHeader *header = sharedHeader();
+                    header->spsc = (spsc) ? 1 : 0;
+                    header->head = 0;
+                    header->consumer_parked = 0;
+                    header->tail = 0;
+                    header->producer_parked = 0;
                 }
 
 #if defined(_WIN32)
@@ -684,17 +1229,27 @@ namespace Platform
 
             bool writeHasEnoughSpace(uint32_t size, bool lock_if_true = false)
             {
+                // SPSC mode: lock_if_true is ignored, only this writer can use the space
+                if (spsc)
+                {
+                    if (queue_buffer_handle == BUFFER_HANDLE_nullptr)
+                        return false;
+                    spscCheckSize(size);
+                    uint32_t padding;
+                    uint32_t size_request = spscRequestSize(size, &padding);
+                    return spscFreeSpace(size_request) >= size_request;
+                }
 
                 Platform::AutoLock autoLock(&shm_mutex);
                 if (queue_semaphore == nullptr)
                     return false;
 
-                uint32_t size_request = size + sizeof(BufferHeader);
-
-                ITK_ABORT(size_request > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
+                ITK_ABORT(size + sizeof(BufferHeader) > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
 
                 lock();
 
+                uint32_t padding;
+                uint32_t size_request = write_request_size(size, &padding);
                 uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
 
                 if (size_request <= remaining_space)
@@ -715,155 +1270,117 @@ namespace Platform
 
             bool write(const uint8_t *data, uint32_t size, bool blocking = true, bool ignore_first_lock = false)
             {
-
-                shm_mutex.lock();
-                if (queue_semaphore == nullptr)
-                {
-                    shm_mutex.unlock();
+                uint8_t *payload = (spsc) ? spscReserve(size, blocking, ignore_first_lock) : reserve_payload(size, blocking, ignore_first_lock);
+                if (payload == nullptr)
                     return false;
-                }
-
-                uint32_t size_request = size + sizeof(BufferHeader);
 
-                ITK_ABORT(size_request > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
-
-                if (!ignore_first_lock)
-                {
-                    if (can_write_cond_mutex != nullptr)
-                    {
-                        //printf("trying to lock mutex cond\n");
-                        AutoLockSemaphoreIPC ipc_lock(can_write_cond_mutex);
-                        if (ipc_lock.signaled) {
-                            shm_mutex.unlock();
-                            return false;
-                        }
+                if (size > 0)
+                    memcpy(payload, data, size);
+                commit(size);
 
-                        // use condition
-                        lock();
-                        uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                        while (size_request > remaining_space)
-                        {
-                            unlock();
-                            shm_mutex.unlock();
+                return true;
+            }
 
-                            if (!blocking)
-                                return false;
+            bool write(const ObjectBuffer &inputBuffer, bool blocking = true, bool ignore_first_lock = false)
+            {
+                return write(inputBuffer.data, (uint32_t)inputBuffer.size, blocking, ignore_first_lock);
+            }
 
-                            //printf("wait cond\n");
-                            bool signaled = false;
-                            can_write_cond->wait(can_write_cond_mutex, &signaled);
-                            if (signaled) {
-                                ipc_lock.cancelAutoRelease();
-                                return false;
-                            }
+            bool read(ObjectBuffer *outputBuffer, bool *_signaled = nullptr)
+            {
+                uint32_t size;
+                const uint8_t *payload = peek(&size, _signaled);
+                if (payload == nullptr)
+                    return false;
 
-                            shm_mutex.lock();
-                            if (queue_semaphore == nullptr)
-                            {
-                                shm_mutex.unlock();
-                                return false;
-                            }
-                            lock();
-                            remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                        }
-                    }
-                    else
-                    {
+                outputBuffer->setSize(size);
+                if (size > 0)
+                    memcpy(outputBuffer->data, payload, size);
+                release();
 
-                        lock();
-                        uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                        while (size_request > remaining_space)
-                        {
-                            unlock();
-                            shm_mutex.unlock();
+                return true;
+            }
 
-                            if (!blocking || Platform::Thread::isCurrentThreadInterrupted())
-                                return false;
+            /// \brief Reserve a message directly in the shared memory.
+            ///
+            /// The queue stays locked until commit() (except in SPSC mode).
+            ///
+            /// \param size payload size
+            /// \param blocking wait until there is space
+            /// \return pointer to size writable bytes, or nullptr (not blocking, interrupted or released)
+            ///
+            uint8_t *reserve(uint32_t size, bool blocking = true)
+            {
+                if (spsc)
+                    return spscReserve(size, blocking, false);
+                return reserve_payload(size, blocking, false);
+            }
 
-                            // maybe the yield give us a better result...but increases the CPU usage
-                            // Platform::Sleep::millis(1);
-                            Platform::Sleep::yield();
+            /// \brief Publish the reserved message.
+            ///
+            /// \param size bytes written, up to the reserved size (UINT32_MAX: the reserved size)
+            ///
+            void commit(uint32_t size = UINT32_MAX)
+            {
+                ITK_ABORT(reserved_size == UINT32_MAX, "LowLatencyQueueIPC commit without reserve.\n");
+                if (size == UINT32_MAX)
+                    size = reserved_size;
+                ITK_ABORT(size > reserved_size, "LowLatencyQueueIPC commit bigger than the reserved size.\n");
+                reserved_size = UINT32_MAX;
 
-                            shm_mutex.lock();
-                            if (queue_semaphore == nullptr)
-                            {
-                                shm_mutex.unlock();
-                                return false;
-                            }
-                            lock();
-                            remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                        }
-                    }
+                if (spsc)
+                {
+                    spscCommit(size);
+                    return;
                 }
 
                 BufferHeader bufferHeader;
                 bufferHeader.size = size;
+                if (reserved_padding > 0)
+                    bufferHeader.size |= BufferHeader_WRAP;
 
                 write_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
-                write_buffer(data, size);
+                skip_write(reserved_padding + size);
 
-                // if (!ignore_first_lock)
                 unlock();
                 shm_mutex.unlock();
 
                 if (blocking_on_read)
                     semaphore_ipc->release();
-
-                return true;
             }
 
-            bool write(const ObjectBuffer &inputBuffer, bool blocking = true, bool ignore_first_lock = false)
+            /// \brief Get the next message directly from the shared memory.
+            ///
+            /// The queue stays locked until release() (except in SPSC mode).
+            ///
+            /// \param size output payload size
+            /// \return pointer to the payload, or nullptr (empty, interrupted or released)
+            ///
+            const uint8_t *peek(uint32_t *size, bool *_signaled = nullptr)
             {
-                return write(inputBuffer.data, (uint32_t)inputBuffer.size, blocking, ignore_first_lock);
+                if (spsc)
+                    return spscPeek(size, _signaled);
+                return peek_payload(size, _signaled);
             }
 
-            bool read(ObjectBuffer *outputBuffer, bool *_signaled = nullptr)
+            // remove the peeked message from the queue
+            void release()
             {
+                ITK_ABORT(release_size == UINT32_MAX, "LowLatencyQueueIPC release without peek.\n");
 
-                if (blocking_on_read)
-                {
-                    bool signaled = !semaphore_ipc->blockingAcquire();
-                    if (signaled){
-                        if (_signaled != nullptr)
-                            *_signaled = signaled;
-                        return false;
-                    }
-                }
-
-                shm_mutex.lock();
-                if (queue_semaphore == nullptr)
-                {
-                    if (blocking_on_read)
-                        semaphore_ipc->release();
-                    shm_mutex.unlock();
-                    if (_signaled != nullptr)
-                        *_signaled = false;
-                    return false;
-                }
-
-                lock();
-
-                if (queue_header_ptr->size == 0)
+                if (spsc)
                 {
-                    unlock();
-                    shm_mutex.unlock();
-
-                    if (_signaled != nullptr)
-                        *_signaled = false;
-
-                    // printf("ERROR: Trying to read element from an empty queue.\n");
-                    return false;
+                    spscRelease();
+                    release_size = UINT32_MAX;
+                    return;
                 }
 
-                BufferHeader bufferHeader;
-                read_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
-                outputBuffer->setSize(bufferHeader.size);
-                read_buffer(outputBuffer->data, (uint32_t)outputBuffer->size);
+                skip_read(release_size);
+                release_size = UINT32_MAX;
 
                 unlock();
                 shm_mutex.unlock();
 
-
                 if (can_write_cond_mutex != nullptr)
                 {
                     //printf("trying to lock mutex cond\n");
@@ -874,10 +1391,6 @@ namespace Platform
                     //printf("cond->notify_all\n");
                     can_write_cond->notify_all();
                 }
-
-                if (_signaled != nullptr)
-                    *_signaled = false;
-                return true;
             }
 
             ~LowLatencyQueueIPC()
@@ -903,6 +1416,12 @@ namespace Platform
 
                 printf("  capacity:%u\n", queue_header_ptr->capacity);
                 printf("  size:%u\n", queue_header_ptr->size);
+
+                if (spsc)
+                {
+                    printf("  spsc head:%u\n", sharedHeader()->head.load());
+                    printf("  spsc tail:%u\n", sharedHeader()->tail.load());
+                }
             }
 
             // only check if this queue is signaled for the current thread...
@@ -37,11 +37,47 @@ namespace Platform
             uint32_t size;
         };
 
+        // BufferHeader::size flag: the payload starts at the ring offset 0,
+        // the bytes from the header to the end of the ring are padding
+        const uint32_t BufferHeader_WRAP = 0x80000000;
+
+        /// \brief Shared memory queue of variable size messages between processes.
+        ///
+        /// write/read copy the message. The zero-copy API gives a pointer to the
+        /// message in the shared memory:
+        ///
+        /// - reserve(size) returns the payload to fill, commit() publishes it.
+        /// - peek(&size) returns the next payload, release() removes it from the queue.
+        ///
+        /// The payloads are always contiguous in the ring: a payload that would cross the
+        /// end of the ring starts at the ring begin (BufferHeader_WRAP). The queue stays
+        /// locked from reserve to commit and from peek to release, so other readers and writers wait.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// Platform::IPC::QueueIPC queue("frames", Platform::IPC::QueueIPC_WRITE, 4, 4 * 1024 * 1024);
+        ///
+        /// uint8_t *pixels = queue.reserve(frame_size);
+        /// if (pixels != nullptr) {
+        ///     renderTo(pixels);
+        ///     queue.commit();
+        /// }
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        ///
         class QueueIPC : public EventCore::HandleCallback
         {
 
             std::string name;
 
+            // zero-copy state, valid while the queue is locked
+            uint32_t reserved_size;
+            uint32_t reserved_padding;
+            uint32_t release_size;
+
             std::string header_name;
             std::string buffer_name;
             std::string semaphore_name;
@@ -148,6 +184,180 @@ namespace Platform
                 queue_header_ptr->size -= size;
             }
 
+            void skip_write(uint32_t size)
+            {
+                ITK_ABORT(size > (queue_header_ptr->capacity - queue_header_ptr->size), "Error to write more than the buffer size\n.");
+                queue_header_ptr->write_pos = (queue_header_ptr->write_pos + size) % queue_header_ptr->capacity;
+                queue_header_ptr->size += size;
+            }
+
+            void skip_read(uint32_t size)
+            {
+                ITK_ABORT(size > queue_header_ptr->size, "Error to read more than the buffer size\n.");
+                queue_header_ptr->read_pos = (queue_header_ptr->read_pos + size) % queue_header_ptr->capacity;
+                queue_header_ptr->size -= size;
+            }
+
+            // locked: space used by a message, with the padding that keeps the payload contiguous
+            uint32_t write_request_size(uint32_t size, uint32_t *padding)
+            {
+                // rewind the empty ring: a message up to the capacity never needs padding
+                if (queue_header_ptr->size == 0)
+                {
+                    queue_header_ptr->write_pos = 0;
+                    queue_header_ptr->read_pos = 0;
+                }
+                uint32_t payload_pos = (queue_header_ptr->write_pos + sizeof(BufferHeader)) % queue_header_ptr->capacity;
+                uint32_t remaining_space = queue_header_ptr->capacity - payload_pos;
+                *padding = (remaining_space < size) ? remaining_space : 0;
+                return sizeof(BufferHeader) + *padding + size;
+            }
+
+            // locked: reserve without waiting, nullptr if there is no space
+            uint8_t *try_reserve_locked(uint32_t size)
+            {
+                uint32_t padding;
+                uint32_t size_request = write_request_size(size, &padding);
+                if (size_request > queue_header_ptr->capacity - queue_header_ptr->size)
+                    return nullptr;
+
+                reserved_size = size;
+                reserved_padding = padding;
+
+                uint32_t payload_pos = (queue_header_ptr->write_pos + sizeof(BufferHeader) + padding) % queue_header_ptr->capacity;
+                return &queue_buffer_ptr[payload_pos];
+            }
+
+            // locked: publish the reserved message
+            void commit_locked(uint32_t size)
+            {
+                BufferHeader bufferHeader;
+                bufferHeader.size = size;
+                if (reserved_padding > 0)
+                    bufferHeader.size |= BufferHeader_WRAP;
+
+                write_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
+                skip_write(reserved_padding + size);
+
+                reserved_size = UINT32_MAX;
+            }
+
+            // locked: next message of a not empty queue
+            const uint8_t *peek_locked(uint32_t *size)
+            {
+                BufferHeader bufferHeader;
+                read_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
+                if (bufferHeader.size & BufferHeader_WRAP)
+                {
+                    bufferHeader.size &= ~BufferHeader_WRAP;
+                    skip_read(queue_header_ptr->capacity - queue_header_ptr->read_pos);
+                }
+
+                release_size = bufferHeader.size;
+                *size = bufferHeader.size;
+                return &queue_buffer_ptr[queue_header_ptr->read_pos];
+            }
+
+            // locked: remove the peeked message
+            void release_locked()
+            {
+                skip_read(release_size);
+                release_size = UINT32_MAX;
+            }
+
+            // returns locked, or nullptr
+            uint8_t *reserve_payload(uint32_t size, bool blocking, bool ignore_first_lock)
+            {
+                shm_mutex.lock();
+                if (queue_semaphore == nullptr)
+                {
+                    shm_mutex.unlock();
+                    return nullptr;
+                }
+
+                ITK_ABORT(size + sizeof(BufferHeader) > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
+
+                uint8_t *payload;
+                if (!ignore_first_lock)
+                {
+
+                    lock();
+                    while ((payload = try_reserve_locked(size)) == nullptr)
+                    {
+                        unlock();
+                        shm_mutex.unlock();
+
+                        if (!blocking || Platform::Thread::isCurrentThreadInterrupted())
+                            return nullptr;
+
+                        Platform::Sleep::millis(1);
+
+                        shm_mutex.lock();
+                        if (queue_semaphore == nullptr)
+                        {
+                            shm_mutex.unlock();
+                            return nullptr;
+                        }
+                        lock();
+                    }
+                }
+                else
+                {
+                    // writeHasEnoughSpace(size, true) checked the space
+                    payload = try_reserve_locked(size);
+                    ITK_ABORT(payload == nullptr, "Error to write more than the buffer size\n.");
+                }
+
+                return payload;
+            }
+
+            // returns locked, or nullptr
+            const uint8_t *peek_payload(uint32_t *size, bool blocking, bool ignore_first_lock, bool *_signaled)
+            {
+                if (_signaled != nullptr)
+                    *_signaled = false;
+
+                // Platform::AutoLock autoLock(&shm_mutex);
+                shm_mutex.lock();
+                if (queue_semaphore == nullptr)
+                {
+                    shm_mutex.unlock();
+                    return nullptr;
+                }
+
+                if (!ignore_first_lock)
+                {
+                    lock();
+
+                    while (queue_header_ptr->size == 0)
+                    {
+                        unlock();
+                        shm_mutex.unlock();
+
+                        if (!blocking)
+                            return nullptr;
+
+                        if (Platform::Thread::isCurrentThreadInterrupted()){
+                            if (_signaled != nullptr)
+                                *_signaled = true;
+                            return nullptr;
+                        }
+
+                        Platform::Sleep::millis(1);
+
+                        shm_mutex.lock();
+                        if (queue_semaphore == nullptr)
+                        {
+                            shm_mutex.unlock();
+                            return nullptr;
+                        }
+                        lock();
+                    }
+                }
+
+                return peek_locked(size);
+            }
+
             void onAbort(const char *file, int line, const char *message)
             {
                 releaseAll();
@@ -294,6 +504,10 @@ namespace Platform
                 queue_header_handle = BUFFER_HANDLE_nullptr;
                 queue_buffer_handle = BUFFER_HANDLE_nullptr;
 
+                reserved_size = UINT32_MAX;
+                reserved_padding = 0;
+                release_size = UINT32_MAX;
+
                 this->name = name;
 
 #if defined(_WIN32)
@@ -450,7 +664,8 @@ namespace Platform
 
                     queue_header_ptr->queue_size = queue_size_;
                     queue_header_ptr->buffer_size = buffer_size_ + sizeof(BufferHeader);
-                    queue_header_ptr->capacity = queue_header_ptr->buffer_size * queue_header_ptr->queue_size;
+                    // one extra buffer for the padding that keeps the payloads contiguous
+                    queue_header_ptr->capacity = queue_header_ptr->buffer_size * (queue_header_ptr->queue_size + 1);
                     queue_header_ptr->size = 0;
                 }
 
@@ -639,12 +854,12 @@ namespace Platform
                 if (queue_semaphore == nullptr)
                     return false;
 
-                uint32_t size_request = size + sizeof(BufferHeader);
-
-                ITK_ABORT(size_request > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
+                ITK_ABORT(size + sizeof(BufferHeader) > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
 
                 lock();
 
+                uint32_t padding;
+                uint32_t size_request = write_request_size(size, &padding);
                 uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
 
                 if (size_request <= remaining_space)
@@ -666,53 +881,13 @@ namespace Platform
 
             bool write(const uint8_t *data, uint32_t size, bool blocking = true, bool ignore_first_lock = false)
             {
-
-                shm_mutex.lock();
-                if (queue_semaphore == nullptr)
-                {
-                    shm_mutex.unlock();
+                uint8_t *payload = reserve_payload(size, blocking, ignore_first_lock);
+                if (payload == nullptr)
                     return false;
-                }
-
-                uint32_t size_request = size + sizeof(BufferHeader);
 
-                ITK_ABORT(size_request > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
-
-                if (!ignore_first_lock)
-                {
-
-                    lock();
-                    uint32_t remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                    while (size_request > remaining_space)
-                    {
-                        unlock();
-                        shm_mutex.unlock();
-
-                        if (!blocking || Platform::Thread::isCurrentThreadInterrupted())
-                            return false;
-
-                        Platform::Sleep::millis(1);
-
-                        shm_mutex.lock();
-                        if (queue_semaphore == nullptr)
-                        {
-                            shm_mutex.unlock();
-                            return false;
-                        }
-                        lock();
-                        remaining_space = queue_header_ptr->capacity - queue_header_ptr->size;
-                    }
-                }
-
-                BufferHeader bufferHeader;
-                bufferHeader.size = size;
-
-                write_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
-                write_buffer(data, size);
-
-                // if (!ignore_first_lock)
-                unlock();
-                shm_mutex.unlock();
+                if (size > 0)
+                    memcpy(payload, data, size);
+                commit(size);
 
                 return true;
             }
@@ -744,67 +919,163 @@ namespace Platform
 
             bool read(ObjectBuffer *outputBuffer, bool blocking = true, bool ignore_first_lock = false, bool *_signaled = nullptr)
             {
+                uint32_t size;
+                const uint8_t *payload = peek_payload(&size, blocking, ignore_first_lock, _signaled);
+                if (payload == nullptr)
+                    return false;
 
-                // Platform::AutoLock autoLock(&shm_mutex);
-                shm_mutex.lock();
-                if (queue_semaphore == nullptr)
+                outputBuffer->setSize(size);
+                if (size > 0)
+                    memcpy(outputBuffer->data, payload, size);
+                release();
+
+                return true;
+            }
+
+            /// \brief Reserve a message directly in the shared memory.
+            ///
+            /// The queue stays locked until commit().
+            ///
+            /// \param size payload size
+            /// \param blocking wait until there is space
+            /// \return pointer to size writable bytes, or nullptr (not blocking, interrupted or released)
+            ///
+            uint8_t *reserve(uint32_t size, bool blocking = true)
+            {
+                return reserve_payload(size, blocking, false);
+            }
+
+            /// \brief Publish the reserved message and unlock the queue.
+            ///
+            /// \param size bytes written, up to the reserved size (UINT32_MAX: the reserved size)
+            ///
+            void commit(uint32_t size = UINT32_MAX)
+            {
+                ITK_ABORT(reserved_size == UINT32_MAX, "QueueIPC commit without reserve.\n");
+                if (size == UINT32_MAX)
+                    size = reserved_size;
+                ITK_ABORT(size > reserved_size, "QueueIPC commit bigger than the reserved size.\n");
+
+                commit_locked(size);
+
+                unlock();
+                shm_mutex.unlock();
+            }
+
+            /// \brief Get the next message directly from the shared memory.
+            ///
+            /// The queue stays locked until release().
+            ///
+            /// \param size output payload size
+            /// \return pointer to the payload, or nullptr (not blocking, interrupted or released)
+            ///
+            const uint8_t *peek(uint32_t *size, bool blocking = true, bool *_signaled = nullptr)
+            {
+                return peek_payload(size, blocking, false, _signaled);
+            }
+
+            // remove the peeked message and unlock the queue
+            void release()
+            {
+                ITK_ABORT(release_size == UINT32_MAX, "QueueIPC release without peek.\n");
+
+                release_locked();
+
+                unlock();
+                shm_mutex.unlock();
+            }
+
+            /// \brief Write many messages with one lock of the queue.
+            ///
+            /// Waits (if blocking) only for the space of the first message. The next
+            /// messages are written while they fit.
+            ///
+            /// \param inputBuffers messages to write
+            /// \param count number of messages
+            /// \param blocking wait until the first message fits
+            /// \return number of messages written, from the start of inputBuffers
+            ///
+            uint32_t writeBatch(const ObjectBuffer *inputBuffers, uint32_t count, bool blocking = true)
+            {
+                if (count == 0)
+                    return 0;
+
+                // check before locking the queue
                 {
-                    shm_mutex.unlock();
-                    if (_signaled != nullptr)
-                        *_signaled = false;
-                    return false;
+                    Platform::AutoLock autoLock(&shm_mutex);
+                    if (queue_semaphore == nullptr)
+                        return 0;
+                    for (uint32_t i = 0; i < count; i++)
+                        ITK_ABORT(inputBuffers[i].size + sizeof(BufferHeader) > queue_header_ptr->capacity, "Buffer too big for this queue.\n");
                 }
 
-                uint32_t total_chuncks = 0;
+                uint8_t *payload = reserve_payload((uint32_t)inputBuffers[0].size, blocking, false);
+                if (payload == nullptr)
+                    return 0;
 
-                if (!ignore_first_lock)
+                uint32_t written = 0;
+                while (true)
                 {
-                    lock();
+                    uint32_t size = (uint32_t)inputBuffers[written].size;
+                    if (size > 0)
+                        memcpy(payload, inputBuffers[written].data, size);
+                    commit_locked(size);
+                    written++;
+
+                    if (written == count)
+                        break;
+                    payload = try_reserve_locked((uint32_t)inputBuffers[written].size);
+                    if (payload == nullptr)
+                        break;
+                }
 
-                    while (queue_header_ptr->size == 0)
-                    {
-                        unlock();
-                        shm_mutex.unlock();
+                unlock();
+                shm_mutex.unlock();
 
-                        if (!blocking){
-                            if (_signaled != nullptr)
-                                *_signaled = false;
-                            return false;
-                        }
+                return written;
+            }
 
-                        if (Platform::Thread::isCurrentThreadInterrupted()){
-                            if (_signaled != nullptr)
-                                *_signaled = true;
-                            return false;
-                        }
+            /// \brief Read many messages with one lock of the queue.
+            ///
+            /// Waits (if blocking) only for the first message. Then reads the messages
+            /// already in the queue, up to max_count.
+            ///
+            /// \param outputBuffers array of at least max_count buffers
+            /// \param max_count maximum number of messages to read
+            /// \return number of messages read
+            ///
+            uint32_t readBatch(ObjectBuffer *outputBuffers, uint32_t max_count, bool blocking = true, bool *_signaled = nullptr)
+            {
+                if (max_count == 0)
+                {
+                    if (_signaled != nullptr)
+                        *_signaled = false;
+                    return 0;
+                }
 
-                        Platform::Sleep::millis(1);
+                uint32_t size;
+                const uint8_t *payload = peek_payload(&size, blocking, false, _signaled);
+                if (payload == nullptr)
+                    return 0;
 
-                        shm_mutex.lock();
-                        if (queue_semaphore == nullptr)
-                        {
-                            shm_mutex.unlock();
-                            if (_signaled != nullptr)
-                                *_signaled = false;
-                            return false;
-                        }
-                        lock();
-                    }
+                uint32_t count = 0;
+                while (true)
+                {
+                    outputBuffers[count].setSize(size);
+                    if (size > 0)
+                        memcpy(outputBuffers[count].data, payload, size);
+                    release_locked();
+                    count++;
+
+                    if (count == max_count || queue_header_ptr->size == 0)
+                        break;
+                    payload = peek_locked(&size);
                 }
 
-                BufferHeader bufferHeader;
-                read_buffer((uint8_t *)&bufferHeader, sizeof(BufferHeader));
-                outputBuffer->setSize(bufferHeader.size);
-                read_buffer(outputBuffer->data, (uint32_t)outputBuffer->size);
-
-                // if (!ignore_first_lock)
                 unlock();
                 shm_mutex.unlock();
 
-                if (_signaled != nullptr)
-                    *_signaled = false;
-
-                return true;
+                return count;
             }
 
             ~QueueIPC()
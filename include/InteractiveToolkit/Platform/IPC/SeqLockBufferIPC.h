@@ -0,0 +1,196 @@
+#pragma once
+
+#include "../platform_common.h"
+#include "../Sleep.h"
+#include "../../ITKCommon/ITKAbort.h"
+#include "BufferIPC.h"
+
+namespace Platform
+{
+
+    namespace IPC
+    {
+
+        namespace Internal
+        {
+
+            struct SeqLockBufferIPC_Header
+            {
+                // 2 * version, odd while the writer fills the next slot
+                alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> sequence;
+                uint32_t size;
+            };
+
+        }
+
+        /// \brief Shared memory block with the latest value of a state (one writer, many readers).
+        ///
+        /// The block has two slots. The version n is stored in the slot (n & 1).
+        /// The writer fills the slot of the next version while the readers copy the
+        /// last complete one, then publishes the new version. A reader retries only
+        /// if the writer starts to overwrite the slot it is copying (two writes during one copy).
+        ///
+        /// The writer never waits and the readers do not write to the shared memory.
+        /// No semaphore is used after the opening.
+        ///
+        /// version() is one atomic load: readers can skip the copy when the state did not change.
+        /// The version 0 is the zero filled block of the first opening.
+        ///
+        /// Only one thread of one process can write. All processes must use the same size.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// struct Pose { float position[3]; float rotation[4]; };
+        ///
+        /// // tracking process
+        /// Platform::IPC::SeqLockBufferIPC pose_ipc("head_pose", sizeof(Pose));
+        /// pose_ipc.write(&pose, sizeof(Pose));
+        ///
+        /// // render process
+        /// Platform::IPC::SeqLockBufferIPC pose_ipc("head_pose", sizeof(Pose));
+        /// uint32_t last_version = 0;
+        /// Pose pose;
+        /// if (pose_ipc.readIfNewer(&pose, &last_version)) { ... }
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        ///
+        class SeqLockBufferIPC
+        {
+            BufferIPC bufferIPC;
+
+            Internal::SeqLockBufferIPC_Header *header;
+            uint8_t *slots[2];
+            uint32_t size;
+
+            static uint32_t slotStride(uint32_t size)
+            {
+                return (size + ITK_CACHE_LINE_SIZE - 1) & ~(uint32_t)(ITK_CACHE_LINE_SIZE - 1);
+            }
+
+            static uint32_t sharedSize(uint32_t size)
+            {
+                return (uint32_t)sizeof(Internal::SeqLockBufferIPC_Header) + slotStride(size) * 2;
+            }
+
+        public:
+            // deleted copy constructor and assign operator, to avoid copy...
+            SeqLockBufferIPC(const SeqLockBufferIPC &v) = delete;
+            SeqLockBufferIPC &operator=(const SeqLockBufferIPC &v) = delete;
+
+#if defined(__linux__) || defined(__APPLE__)
+            // unlink all resources
+            static void force_shm_unlink(const std::string &name)
+            {
+                BufferIPC::force_shm_unlink(name + std::string("_asl"));
+            }
+#endif
+
+            SeqLockBufferIPC(const char *name = "default",
+                             uint32_t buffer_size_ = 1024) : bufferIPC((std::string(name) + std::string("_asl")).c_str(),
+                                                                       sharedSize(buffer_size_))
+            {
+                header = (Internal::SeqLockBufferIPC_Header *)bufferIPC.data;
+                slots[0] = &bufferIPC.data[sizeof(Internal::SeqLockBufferIPC_Header)];
+                slots[1] = slots[0] + slotStride(buffer_size_);
+                size = buffer_size_;
+
+                if (bufferIPC.isFirstProcess())
+                {
+                    memset(bufferIPC.data, 0, bufferIPC.size);
+                    header->sequence = 0;
+                    header->size = buffer_size_;
+                }
+                else
+                    ITK_ABORT(header->size != buffer_size_, "SeqLockBufferIPC opened with a different size.\n");
+
+                bufferIPC.finishInitialization();
+            }
+
+            uint32_t getSize() const
+            {
+                return size;
+            }
+
+            // number of complete writes
+            uint32_t version() const
+            {
+                return header->sequence.load(std::memory_order_acquire) >> 1;
+            }
+
+            /// \brief Publish a new state (wait-free, single writer).
+            ///
+            /// \param data new state
+            /// \param data_size bytes to copy to the start of the state,
+            /// the bytes after data_size keep the values of the previous version
+            ///
+            void write(const void *data, uint32_t data_size)
+            {
+                ITK_ABORT(data_size > size, "Buffer too big for this SeqLockBufferIPC.\n");
+
+                uint32_t seq = header->sequence.load(std::memory_order_relaxed);
+                uint32_t current_version = seq >> 1;
+                uint8_t *next_slot = slots[(current_version + 1) & 1];
+
+                header->sequence.store(seq + 1, std::memory_order_relaxed);
+                // the odd sequence must be visible before the slot bytes
+                std::atomic_thread_fence(std::memory_order_release);
+                memcpy(next_slot, data, data_size);
+                // the next slot has the version before the current one:
+                // complete it with the tail of the current slot (only the writer changes the slots)
+                if (data_size < size)
+                    memcpy(next_slot + data_size, slots[current_version & 1] + data_size, size - data_size);
+                header->sequence.store(seq + 2, std::memory_order_release);
+            }
+
+            /// \brief Try to copy the latest complete state once.
+            ///
+            /// \param out buffer of getSize() bytes
+            /// \param _version output version of the copied state (optional)
+            /// \return false if the slot was overwritten during the copy
+            ///
+            bool tryRead(void *out, uint32_t *_version = nullptr) const
+            {
+                uint32_t seq_begin = header->sequence.load(std::memory_order_acquire);
+                uint32_t current_version = seq_begin >> 1;
+                memcpy(out, slots[current_version & 1], size);
+                // the bytes must be read before the sequence check
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint32_t seq_end = header->sequence.load(std::memory_order_relaxed);
+                // the writer of current_version + 2 (same slot) makes the sequence base + 3
+                if (seq_end - (seq_begin & ~(uint32_t)1) > 2)
+                    return false;
+                if (_version != nullptr)
+                    *_version = current_version;
+                return true;
+            }
+
+            // lock-free, retries while the slot is overwritten, returns the version
+            uint32_t read(void *out) const
+            {
+                uint32_t result;
+                while (!tryRead(out, &result))
+                    Sleep::cpuRelax();
+                return result;
+            }
+
+            /// \brief Copy the state only if there is a version after last_version
+            ///
+            /// \param out buffer of getSize() bytes
+            /// \param last_version input: version already read, output: version copied
+            /// \return false if the state did not change
+            ///
+            bool readIfNewer(void *out, uint32_t *last_version) const
+            {
+                if (version() == *last_version)
+                    return false;
+                *last_version = read(out);
+                return true;
+            }
+        };
+
+    }
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+//#include "platform_common.h"
+#include "../common.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "Sleep.h"
+#include "Core/Futex.h"
+
+// number of checks before parking the thread in the futex
+#ifndef ITK_LATCH_SPIN_COUNT
+#define ITK_LATCH_SPIN_COUNT 2048
+#endif
+
+namespace Platform
+{
+
+    /// \brief Single use countdown: threads wait until the counter reaches zero.
+    ///
+    /// The waiting threads spin (spin_count checks) before parking in a futex.
+    /// The count down wakes the parked threads only when it reaches zero.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::Latch loaded(asset_count);
+    ///
+    /// // each loader task
+    /// load(asset);
+    /// loaded.countDown();
+    ///
+    /// // main thread
+    /// if (!loaded.wait())
+    ///     return; // interrupted
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class Latch
+    {
+        uint32_t spin_count;
+
+        // value = (counter << 1) | waiters bit
+        //
+        // the waiters bit is in the same word of the counter: after the last
+        // countDown() the latch is not read anymore (a waiter may destroy it)
+        alignas(ITK_CACHE_LINE_SIZE) std::atomic<uint32_t> value;
+
+        static const uint32_t WaitersBit = 1;
+        static const uint32_t CountOne = 2;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        Latch(const Latch &v) = delete;
+        Latch &operator=(const Latch &v) = delete;
+
+        /// \brief Construct the latch
+        ///
+        /// \param count initial counter value
+        /// \param spin_count number of checks before parking (0 parks immediately)
+        ///
+        Latch(uint32_t count, uint32_t spin_count = ITK_LATCH_SPIN_COUNT)
+        {
+            this->spin_count = spin_count;
+            value = count * CountOne;
+        }
+
+        void countDown(uint32_t n = 1)
+        {
+            std::atomic<uint32_t> *address = &value;
+            uint32_t previous = address->fetch_sub(n * CountOne);
+            ITK_ABORT((previous >> 1) < n, "Latch counter decremented below zero.\n");
+            if ((previous >> 1) == n && (previous & WaitersBit) != 0)
+                Futex::wakeAll(address);
+        }
+
+        bool tryWait() const
+        {
+            return value.load(std::memory_order_acquire) < CountOne;
+        }
+
+        /// \brief Wait the counter to reach zero
+        ///
+        /// \param ignore_signal if true, the wait is not interrupted by Thread::interrupt()
+        /// \return false if the current thread was interrupted before the counter reached zero
+        ///
+        bool wait(bool ignore_signal = false)
+        {
+            for (uint32_t i = 0; i < spin_count; i++)
+            {
+                if (value.load(std::memory_order_acquire) < CountOne)
+                    return true;
+                Sleep::cpuRelax();
+            }
+
+            uint32_t v = value.load(std::memory_order_acquire);
+            while (v >= CountOne)
+            {
+                // mark the word before parking, the last countDown() will wake
+                if ((v & WaitersBit) == 0)
+                {
+                    if (!value.compare_exchange_weak(v, v | WaitersBit, std::memory_order_acquire, std::memory_order_acquire))
+                        continue;
+                    v |= WaitersBit;
+                }
+                if (Futex::waitInterruptible(&value, v, UINT32_MAX, ignore_signal) == FutexWaitResult::Interrupted &&
+                    value.load(std::memory_order_acquire) >= CountOne)
+                    return false;
+                v = value.load(std::memory_order_acquire);
+            }
+            return true;
+        }
+
+        bool arriveAndWait(bool ignore_signal = false)
+        {
+            countDown();
+            return wait(ignore_signal);
+        }
+    };
+
+}
@@ -3,6 +3,12 @@
 // #include "platform_common.h"
 #include "../common.h"
 #include "Sleep.h"
+#include "Core/Futex.h"
+
+// number of tries before parking the thread in the futex
+#ifndef ITK_MUTEX_SPIN_COUNT
+#define ITK_MUTEX_SPIN_COUNT 64
+#endif
 
 namespace Platform
 {
@@ -29,7 +35,20 @@ namespace Platform
     private:
 #if defined(_WIN32)
         CRITICAL_SECTION mLock;
-#elif defined(__APPLE__) || defined(__linux__)
+#elif defined(__linux__)
+        // 0: unlocked, 1: locked, 2: locked with waiters
+        std::atomic<uint32_t> state;
+        // owner thread token, used to make the mutex recursive
+        std::atomic<uintptr_t> owner;
+        uint32_t recursion;
+
+        // unique address per thread, does not depend on the Thread class
+        static ITK_INLINE uintptr_t currentThreadToken()
+        {
+            static thread_local char token;
+            return (uintptr_t)&token;
+        }
+#elif defined(__APPLE__)
         pthread_mutex_t mLock;
 #endif
 
@@ -47,7 +66,11 @@ namespace Platform
         {
 #if defined(_WIN32)
             InitializeCriticalSection(&mLock);
-#elif defined(__APPLE__) || defined(__linux__)
+#elif defined(__linux__)
+            state = 0;
+            owner = 0;
+            recursion = 0;
+#elif defined(__APPLE__)
             // Set it recursive
             pthread_mutexattr_t attributes;
             pthread_mutexattr_init(&attributes);
@@ -65,7 +88,8 @@ namespace Platform
         {
 #if defined(_WIN32)
             DeleteCriticalSection(&mLock);
-#elif defined(__APPLE__) || defined(__linux__)
+#elif defined(__linux__)
+#elif defined(__APPLE__)
             pthread_mutex_destroy(&mLock);
 #endif
         }
@@ -100,7 +124,17 @@ namespace Platform
         {
 #if defined(_WIN32)
             LeaveCriticalSection(&mLock);
-#elif defined(__APPLE__) || defined(__linux__)
+#elif defined(__linux__)
+            if (--recursion > 0)
+                return;
+            owner.store(0, std::memory_order_relaxed);
+            // only enter the kernel if there are waiters
+            if (state.fetch_sub(1, std::memory_order_release) != 1)
+            {
+                state.store(0, std::memory_order_release);
+                Futex::wakeOne(&state);
+            }
+#elif defined(__APPLE__)
             pthread_mutex_unlock(&mLock);
 #endif
         }
@@ -9,7 +9,47 @@ namespace Platform
         {
 #if defined(_WIN32)
             EnterCriticalSection(&mLock);
-#elif defined(__APPLE__) || defined(__linux__)
+#elif defined(__linux__)
+            uintptr_t token = currentThreadToken();
+            // only the owner thread can store its own token
+            if (owner.load(std::memory_order_relaxed) == token)
+            {
+                recursion++;
+                return;
+            }
+
+            uint32_t c = 0;
+            if (!state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                bool acquired = false;
+                uint32_t spin_count = Platform::Sleep::spinCount(ITK_MUTEX_SPIN_COUNT);
+                for (uint32_t i = 0; i < spin_count; i++)
+                {
+                    Platform::Sleep::cpuRelax();
+                    c = 0;
+                    // the weak exchange can fail with c == 0
+                    if (state.compare_exchange_weak(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    {
+                        acquired = true;
+                        break;
+                    }
+                }
+                // Drepper, "Futexes Are Tricky": mark as contended and park
+                if (!acquired)
+                {
+                    if (c != 2)
+                        c = state.exchange(2, std::memory_order_acquire);
+                    while (c != 0)
+                    {
+                        Futex::waitRaw(&state, 2);
+                        c = state.exchange(2, std::memory_order_acquire);
+                    }
+                }
+            }
+
+            owner.store(token, std::memory_order_relaxed);
+            recursion = 1;
+#elif defined(__APPLE__)
             int max_tries = 0;
             while (pthread_mutex_lock(&mLock) != 0)
             {
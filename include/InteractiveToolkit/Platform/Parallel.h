@@ -0,0 +1,308 @@
+#pragma once
+
+#include "../common.h"
+#include "../EventCore/Callback.h"
+#include "Mutex.h"
+#include "AutoLock.h"
+#include "Semaphore.h"
+#include "ThreadPool.h"
+#include "Core/Futex.h"
+
+// maximum number of blocks used by parallel_inclusive_scan (stack storage)
+#ifndef ITK_PARALLEL_SCAN_MAX_BLOCKS
+#define ITK_PARALLEL_SCAN_MAX_BLOCKS 256
+#endif
+
+namespace Platform
+{
+
+    /// \brief Splits [begin, end) in chunks that are claimed by the calling thread
+    /// and by helper tasks posted to the ThreadPool.
+    ///
+    /// The chunk size is adaptive (guided): large chunks at the start, shrinking
+    /// towards the grain size at the end of the range.
+    ///
+    /// The job lives in the stack of the caller. Helpers are posted as class member
+    /// callbacks, so no memory is allocated per call or per chunk.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename Participant>
+    class ParallelRangeJob : public EventCore::HandleCallback
+    {
+        ThreadPool *pool;
+        Participant *participant;
+
+        std::atomic<int64_t> next_index;
+        int64_t end_index;
+        int64_t grain;
+        int64_t divisor;
+
+        // the caller waits on this word: the last helper does not
+        // touch the job after the decrement (the wake uses only the address)
+        std::atomic<uint32_t> helpers_pending;
+
+        void helperEntry()
+        {
+            participant->participate(this);
+            std::atomic<uint32_t> *address = &helpers_pending;
+            if (address->fetch_sub(1) == 1)
+                Futex::wakeAll(address);
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        ParallelRangeJob(const ParallelRangeJob &v) = delete;
+        ParallelRangeJob &operator=(const ParallelRangeJob &v) = delete;
+
+        ParallelRangeJob(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, Participant *participant)
+        {
+            this->pool = pool;
+            this->participant = participant;
+            next_index = begin;
+            end_index = end;
+            this->grain = (grain < 1) ? 1 : grain;
+            divisor = 1;
+            helpers_pending = 0;
+        }
+
+        // claim the next chunk of the range
+        bool next(int64_t *chunk_begin, int64_t *chunk_end)
+        {
+            int64_t current = next_index.load(std::memory_order_relaxed);
+            while (current < end_index)
+            {
+                int64_t remaining = end_index - current;
+                int64_t chunk = remaining / divisor;
+                if (chunk < grain)
+                    chunk = grain;
+                if (chunk > remaining)
+                    chunk = remaining;
+                if (next_index.compare_exchange_weak(current, current + chunk, std::memory_order_relaxed))
+                {
+                    *chunk_begin = current;
+                    *chunk_end = current + chunk;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void run()
+        {
+            int64_t total = end_index - next_index.load(std::memory_order_relaxed);
+            if (total <= 0)
+                return;
+
+            int64_t max_chunks = (total + grain - 1) / grain;
+            int64_t helpers = (pool != nullptr) ? (int64_t)pool->threadCount() : 0;
+            if (helpers > max_chunks - 1)
+                helpers = max_chunks - 1;
+
+            divisor = (helpers + 1) * 2;
+
+            if (helpers > 0)
+            {
+                helpers_pending = (uint32_t)helpers;
+                for (int64_t i = 0; i < helpers; i++)
+                    pool->postTask(EventCore::CallbackWrapper(&ParallelRangeJob::helperEntry, this));
+            }
+
+            // the calling thread takes part in the work
+            participant->participate(this);
+
+            // wait all posted helpers, because they reference this job.
+            // While waiting, run other pool tasks (may be our own helpers).
+            // The zero is observed on the futex word itself, so the job
+            // is released only after the last helper access.
+            uint32_t pending;
+            while ((pending = helpers_pending.load()) > 0)
+            {
+                // nothing left in the queues: our helpers are running
+                if (!pool->runPendingTask())
+                    Futex::waitRaw(&helpers_pending, pending);
+            }
+        }
+    };
+
+    template <typename Function>
+    struct ParallelForParticipant
+    {
+        const Function *fnc;
+
+        template <typename Job>
+        void participate(Job *job)
+        {
+            int64_t chunk_begin, chunk_end;
+            while (job->next(&chunk_begin, &chunk_end))
+                (*fnc)(chunk_begin, chunk_end);
+        }
+    };
+
+    template <typename T, typename Function, typename Combine>
+    struct ParallelReduceParticipant
+    {
+        const Function *fnc;
+        const Combine *combine;
+        const T *identity;
+
+        Platform::Mutex mutex;
+        T result;
+
+        template <typename Job>
+        void participate(Job *job)
+        {
+            T local = *identity;
+            bool has_value = false;
+            int64_t chunk_begin, chunk_end;
+            while (job->next(&chunk_begin, &chunk_end))
+            {
+                local = (*fnc)(chunk_begin, chunk_end, local);
+                has_value = true;
+            }
+            if (!has_value)
+                return;
+            Platform::AutoLock lock(&mutex);
+            result = (*combine)(result, local);
+        }
+    };
+
+    /// \brief Run fnc(chunk_begin, chunk_end) over [begin, end) using the ThreadPool.
+    ///
+    /// The calling thread also executes chunks and returns after all chunks are done.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::parallel_for(&threadPool, 0, count, 1024,
+    ///     [&](int64_t begin, int64_t end){
+    ///         for (int64_t i = begin; i < end; i++)
+    ///             output[i] = input[i] * 2;
+    ///     });
+    /// \endcode
+    ///
+    /// \param pool the ThreadPool used for the helper tasks (can be nullptr to run serial)
+    /// \param grain minimum number of indices of a chunk
+    ///
+    template <typename Function>
+    static inline void parallel_for(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, const Function &fnc)
+    {
+        ParallelForParticipant<Function> participant;
+        participant.fnc = &fnc;
+        ParallelRangeJob<ParallelForParticipant<Function>> job(pool, begin, end, grain, &participant);
+        job.run();
+    }
+
+    /// \brief Reduce [begin, end) using the ThreadPool.
+    ///
+    /// Each participant folds its chunks with fnc(chunk_begin, chunk_end, accumulator) -> T,
+    /// starting from identity. Partial results are merged with combine(a, b) -> T.
+    ///
+    /// combine must be associative and commutative: the merge order depends on the thread scheduling.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// int64_t sum = Platform::parallel_reduce(&threadPool, 0, count, 4096, (int64_t)0,
+    ///     [&](int64_t begin, int64_t end, int64_t acc){
+    ///         for (int64_t i = begin; i < end; i++)
+    ///             acc += values[i];
+    ///         return acc;
+    ///     },
+    ///     [](int64_t a, int64_t b){ return a + b; });
+    /// \endcode
+    ///
+    template <typename T, typename Function, typename Combine>
+    static inline T parallel_reduce(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, const T &identity, const Function &fnc, const Combine &combine)
+    {
+        ParallelReduceParticipant<T, Function, Combine> participant;
+        participant.fnc = &fnc;
+        participant.combine = &combine;
+        participant.identity = &identity;
+        participant.result = identity;
+        ParallelRangeJob<ParallelReduceParticipant<T, Function, Combine>> job(pool, begin, end, grain, &participant);
+        job.run();
+        return participant.result;
+    }
+
+    /// \brief Inclusive prefix scan of [first, last) into d_first using the ThreadPool.
+    ///
+    /// d_first[i] = first[0] op first[1] op ... op first[i]
+    ///
+    /// The range is split in at most ITK_PARALLEL_SCAN_MAX_BLOCKS blocks. The block totals are computed
+    /// in parallel, scanned in the calling thread, and each block is then scanned in parallel with its offset.
+    ///
+    /// op must be associative. identity must be the neutral element of op.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::parallel_inclusive_scan(&threadPool, input, input + count, output, 4096, 0u,
+    ///     [](uint32_t a, uint32_t b){ return a + b; });
+    /// \endcode
+    ///
+    template <typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+    static inline void parallel_inclusive_scan(ThreadPool *pool, InputIt first, InputIt last, OutputIt d_first, int64_t grain, const T &identity, const BinaryOp &op)
+    {
+        int64_t count = (int64_t)(last - first);
+        if (count <= 0)
+            return;
+        if (grain < 1)
+            grain = 1;
+
+        int64_t block_count = (count + grain - 1) / grain;
+        int64_t max_blocks = (pool != nullptr) ? (int64_t)(pool->threadCount() + 1) * 4 : 1;
+        if (max_blocks > ITK_PARALLEL_SCAN_MAX_BLOCKS)
+            max_blocks = ITK_PARALLEL_SCAN_MAX_BLOCKS;
+        if (block_count > max_blocks)
+            block_count = max_blocks;
+        int64_t block_size = (count + block_count - 1) / block_count;
+
+        T block_offset[ITK_PARALLEL_SCAN_MAX_BLOCKS];
+
+        // block totals
+        parallel_for(pool, 0, block_count, 1,
+                     [&](int64_t block_begin, int64_t block_end)
+                     {
+                         for (int64_t block = block_begin; block < block_end; block++)
+                         {
+                             int64_t i = block * block_size;
+                             int64_t i_end = (i + block_size < count) ? i + block_size : count;
+                             T acc = identity;
+                             for (; i < i_end; i++)
+                                 acc = op(acc, first[i]);
+                             block_offset[block] = acc;
+                         }
+                     });
+
+        // exclusive scan of the block totals
+        T acc = identity;
+        for (int64_t block = 0; block < block_count; block++)
+        {
+            T block_total = block_offset[block];
+            block_offset[block] = acc;
+            acc = op(acc, block_total);
+        }
+
+        // scan each block starting from its offset
+        parallel_for(pool, 0, block_count, 1,
+                     [&](int64_t block_begin, int64_t block_end)
+                     {
+                         for (int64_t block = block_begin; block < block_end; block++)
+                         {
+                             int64_t i = block * block_size;
+                             int64_t i_end = (i + block_size < count) ? i + block_size : count;
+                             T block_acc = block_offset[block];
+                             for (; i < i_end; i++)
+                             {
+                                 block_acc = op(block_acc, first[i]);
+                                 d_first[i] = block_acc;
+                             }
+                         }
+                     });
+    }
+
+}
@@ -5,9 +5,16 @@
 #include "Core/ObjectBuffer.h"
 #include "Core/ObjectPool.h"
 #include "Core/ObjectQueue.h"
+#include "Core/MPMCQueue.h"
+#include "Core/SPSCQueue.h"
 #include "Core/SmartVector.h"
+#include "Core/EpochManager.h"
+#include "Core/SeqLock.h"
+#include "Core/Snapshot.h"
+#include "Core/ConcurrentHashMap.h"
 
 #include "AutoLock.h"
+#include "CPUTopology.h"
 #include "Mutex.h"
 #include "Process.h"
 #include "Semaphore.h"
@@ -16,21 +23,34 @@
 #include "SocketTCP.h"
 #include "SocketUDP.h"
 #include "Thread.h"
+#include "ThreadPoolMetrics.h"
 #include "ThreadPool.h"
+#include "Parallel.h"
+#include "TaskFuture.h"
+#include "TaskGraph.h"
+#include "TaskGroup.h"
+#include "TimerWheel.h"
+#include "FiberExecutor.h"
+#include "FiberSemaphore.h"
+#include "FiberQueue.h"
 #include "ThreadWithParameters.h"
 #include "Time.h"
 
 #include "AutoLockSemaphore.h"
 
 #include "Condition.h"
+#include "Barrier.h"
+#include "Latch.h"
 
 //
 // IPC
 //
+#include "IPC/BroadcastRingIPC.h"
 #include "IPC/BufferIPC.h"
 #include "IPC/LowLatencyQueueIPC.h"
 #include "IPC/QueueIPC.h"
 #include "IPC/SemaphoreIPC.h"
+#include "IPC/SeqLockBufferIPC.h"
 
 #include "IPC/AutoLockSemaphoreIPC.h"
 
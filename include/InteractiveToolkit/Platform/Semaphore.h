@@ -9,6 +9,13 @@
     #include "Core/unamed_fake_sem.h"
 #endif
 
+#include "Core/Futex.h"
+
+// number of tries before parking the thread in the futex
+#ifndef ITK_SEMAPHORE_SPIN_COUNT
+#define ITK_SEMAPHORE_SPIN_COUNT 64
+#endif
+
 namespace Platform
 {
 
@@ -18,7 +25,111 @@ namespace Platform
 #if defined(_WIN32)
         HANDLE semaphore;
 #elif defined(__linux__)
-        sem_t semaphore;
+        // the count is changed in user space,
+        // the futex syscall is done only when a thread needs to wait
+        //
+        // value = (count << 1) | waiters bit
+        //
+        // the waiters bit is in the same word of the count: release() is one
+        // atomic operation, and after it the semaphore is not read anymore
+        // (the thread that takes the token may destroy the semaphore)
+        std::atomic<uint32_t> value;
+        // only changed by the waiting threads
+        std::atomic<uint32_t> waiters;
+
+        static const uint32_t WaitersBit = 1;
+        static const uint32_t CountOne = 2;
+
+        bool tryDecrement()
+        {
+            uint32_t v = value.load(std::memory_order_relaxed);
+            while (v >= CountOne)
+            {
+                if (value.compare_exchange_weak(v, v - CountOne, std::memory_order_acquire, std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        static uint64_t monotonicMillis()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (uint64_t)ts.tv_sec * UINT64_C(1000) + (uint64_t)(ts.tv_nsec / 1000000L);
+        }
+
+        // returns false on timeout or interruption
+        bool waitDecrement(uint32_t timeout_ms, bool ignore_signal)
+        {
+            uint32_t spin_count = Sleep::spinCount(ITK_SEMAPHORE_SPIN_COUNT);
+            for (uint32_t i = 0; i < spin_count; i++)
+            {
+                Sleep::cpuRelax();
+                if (tryDecrement())
+                    return true;
+            }
+
+            uint64_t deadline = 0;
+            if (timeout_ms != UINT32_MAX)
+                deadline = monotonicMillis() + timeout_ms;
+
+            bool result = false;
+            waiters.fetch_add(1);
+            uint32_t v = value.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if (v >= CountOne)
+                {
+                    if (value.compare_exchange_weak(v, v - CountOne, std::memory_order_acquire, std::memory_order_relaxed))
+                    {
+                        result = true;
+                        break;
+                    }
+                    continue;
+                }
+
+                // count is zero: mark the word before parking, release() will wake
+                if ((v & WaitersBit) == 0)
+                {
+                    if (!value.compare_exchange_weak(v, v | WaitersBit, std::memory_order_relaxed, std::memory_order_relaxed))
+                        continue;
+                    v |= WaitersBit;
+                }
+
+                uint32_t remaining = UINT32_MAX;
+                if (timeout_ms != UINT32_MAX)
+                {
+                    uint64_t now = monotonicMillis();
+                    if (now >= deadline)
+                        break;
+                    remaining = (uint32_t)(deadline - now);
+                }
+
+                if (Futex::waitInterruptible(&value, v, remaining, ignore_signal) == FutexWaitResult::Interrupted)
+                    break;
+                v = value.load(std::memory_order_relaxed);
+            }
+
+            // the last waiter clears the bit
+            uint32_t waiters_guess = waiters.load();
+            if (waiters_guess == 1)
+                value.fetch_and(~WaitersBit);
+            uint32_t waiters_final = waiters.fetch_sub(1);
+            if (waiters_final > 1 && waiters_guess == 1)
+            {
+                // a new waiter might have parked before the bit was cleared:
+                // set it again and wake one thread per available token
+                v = value.fetch_or(WaitersBit);
+                for (uint32_t i = 0; i < (v >> 1); i++)
+                    Futex::wakeOne(&value);
+            }
+            else if (!result && waiters_final > 1 && value.load() >= CountOne)
+            {
+                // the wake of this thread may be for a token it did not take
+                Futex::wakeOne(&value);
+            }
+            return result;
+        }
 #elif defined(__APPLE__)
         fake_sem_t semaphore;
 #endif
@@ -40,7 +151,8 @@ namespace Platform
             );
             ITK_ABORT(semaphore == nullptr, "CreateSemaphore error: %s\n", ITKPlatformUtil::win32_GetLastErrorToString().c_str());
 #elif defined(__linux__)
-            sem_init(&semaphore, 0, count); // 0 means is a semaphore bound to threads
+            value = (uint32_t)count * CountOne;
+            waiters = 0;
 #elif defined(__APPLE__)
             fake_sem_init(&semaphore, 0, count);
 #endif
@@ -52,7 +164,6 @@ namespace Platform
                 CloseHandle(semaphore);
             semaphore = nullptr;
 #elif defined(__linux__)
-            sem_destroy(&semaphore);
 #elif defined(__APPLE__)
             fake_sem_destroy(&semaphore);
 #endif
@@ -60,6 +171,15 @@ namespace Platform
 
         bool tryToAcquire(uint32_t timeout_ms = 0, bool ignore_signal = false)
         {
+#if defined(__linux__)
+            if ((!ignore_signal) && isSignaled())
+                return false;
+            if (tryDecrement())
+                return true;
+            if (timeout_ms == 0)
+                return false;
+            return waitDecrement(timeout_ms, ignore_signal);
+#else
             Platform::Thread *currentThread = Platform::Thread::getCurrentThread();
 
 #if defined(__linux__) || defined(__APPLE__)
@@ -106,50 +226,6 @@ namespace Platform
 
             // true if the semaphore is signaled (might have the interrupt or not...)
             return dwWaitResult == WAIT_OBJECT_0 + 0;
-#elif defined(__linux__)
-            if (timeout_ms == 0)
-            {
-                currentThread->semaphoreUnLock();
-                return sem_trywait(&semaphore) == 0;
-            }
-
-            struct timespec ts;
-            if (clock_gettime(CLOCK_REALTIME, &ts))
-            {
-                currentThread->semaphoreUnLock();
-                ITK_ABORT(true, "clock_gettime error\n");
-            }
-
-            struct timespec ts_increment;
-            ts_increment.tv_sec = timeout_ms / 1000;
-            ts_increment.tv_nsec = ((long)timeout_ms % 1000L) * 1000000L;
-
-            ts.tv_nsec += ts_increment.tv_nsec;
-            ts.tv_sec += ts.tv_nsec / 1000000000L;
-            ts.tv_nsec = ts.tv_nsec % 1000000000L;
-
-            ts.tv_sec += ts_increment.tv_sec;
-
-            currentThread->semaphoreWaitBegin(&semaphore);
-            currentThread->semaphoreUnLock();
-            int s = sem_timedwait(&semaphore, &ts);
-
-            if (ignore_signal){
-                while ((s == -1 && errno != ETIMEDOUT))
-                    s = sem_timedwait(&semaphore, &ts);
-            }
-
-            currentThread->semaphoreWaitDone(&semaphore);
-
-            // currentThread->isCurrentThreadInterrupted() ||
-            if ((s == -1 && errno != ETIMEDOUT))
-            {
-                // interrupt signaled
-                // signaled = true;
-                return false;
-            }
-
-            return s == 0;
 #elif defined(__APPLE__)
             if (timeout_ms == 0)
             {
@@ -192,6 +268,7 @@ namespace Platform
             }
 
             return s == 0;
+#endif
 #endif
         }
 
@@ -207,33 +284,11 @@ namespace Platform
 
 #elif defined(__linux__)
 
-            Platform::Thread *currentThread = Platform::Thread::getCurrentThread();
-
-            currentThread->semaphoreLock();
-
-            bool signaled = (!ignore_signal) && isSignaled();
-
-            if (signaled)
-            {
-                currentThread->semaphoreUnLock();
-            }
-            else
-            {
-                currentThread->semaphoreWaitBegin(&semaphore);
-                currentThread->semaphoreUnLock();
-
-                // signaled = signaled || (sem_wait(&semaphore) != 0);
-                signaled = (sem_wait(&semaphore) != 0);
-                if (ignore_signal)
-                {
-                    while (signaled)
-                        signaled = (sem_wait(&semaphore) != 0);
-                }
-
-                currentThread->semaphoreWaitDone(&semaphore);
-            }
-
-            return !signaled;
+            if ((!ignore_signal) && isSignaled())
+                return false;
+            if (tryDecrement())
+                return true;
+            return waitDecrement(UINT32_MAX, ignore_signal);
 
 #elif defined(__APPLE__)
             Platform::Thread *currentThread = Platform::Thread::getCurrentThread();
@@ -271,7 +326,11 @@ namespace Platform
             BOOL result = ReleaseSemaphore(semaphore, 1, nullptr);
             ITK_ABORT(!result, "ReleaseSemaphore error: %s\n", ITKPlatformUtil::win32_GetLastErrorToString().c_str());
 #elif defined(__linux__)
-            sem_post(&semaphore);
+            // after this add the semaphore can be destroyed by the thread
+            // that takes the token, the wake uses only the address
+            uint32_t previous = value.fetch_add(CountOne, std::memory_order_release);
+            if ((previous & WaitersBit) != 0)
+                Futex::wakeOne(&value);
 #elif defined(__APPLE__)
             fake_sem_post(&semaphore);
 #endif
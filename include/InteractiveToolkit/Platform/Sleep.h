@@ -127,6 +127,38 @@ namespace Platform
             sched_yield();
 #endif
         }
+
+        /// \brief Hint the CPU that the current thread is in a spin-wait loop.
+        ///
+        /// Does not leave the CPU. Use it inside short busy loops before parking the thread.
+        ///
+        /// \author Alessandro Ribeiro
+        ///
+        static ITK_INLINE void cpuRelax()
+        {
+#if defined(_WIN32)
+            YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#else
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+        }
+
+        /// \brief Number of spin-wait iterations to do before parking the thread.
+        ///
+        /// Returns 0 on a single CPU machine: there the spin only delays the thread
+        /// that would release the waiter.
+        ///
+        /// \author Alessandro Ribeiro
+        ///
+        static ITK_INLINE uint32_t spinCount(uint32_t count)
+        {
+            static const bool single_cpu = std::thread::hardware_concurrency() == 1;
+            return (single_cpu) ? 0 : count;
+        }
     };
 
 }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "../common.h"
+#include "../EventCore/Callback.h"
+#include "Semaphore.h"
+
+namespace Platform
+{
+
+    // opaque pointer...
+    class ThreadPool;
+
+    template <typename T>
+    struct TaskFutureValue
+    {
+        using get_type = const T &;
+
+        T value;
+
+        void run(const EventCore::Callback<T()> &task)
+        {
+            value = task();
+        }
+        const T &get() const
+        {
+            return value;
+        }
+    };
+
+    template <>
+    struct TaskFutureValue<void>
+    {
+        using get_type = void;
+
+        void run(const EventCore::Callback<void()> &task)
+        {
+            task();
+        }
+        void get() const
+        {
+        }
+    };
+
+    template <typename T>
+    class TaskFutureState
+    {
+    public:
+        std::atomic<bool> ready;
+        Platform::Semaphore semaphore;
+        ThreadPool *pool;
+        TaskFutureValue<T> storage;
+
+        // deleted copy constructor and assign operator, to avoid copy...
+        TaskFutureState(const TaskFutureState &v) = delete;
+        TaskFutureState &operator=(const TaskFutureState &v) = delete;
+
+        TaskFutureState(ThreadPool *pool) : semaphore(0)
+        {
+            ready = false;
+            this->pool = pool;
+        }
+
+        void run(const EventCore::Callback<T()> &task)
+        {
+            storage.run(task);
+            ready.store(true, std::memory_order_release);
+            semaphore.release();
+        }
+
+        bool wait(bool ignore_signal);
+    };
+
+    /// \brief Handle to the result of a task posted with ThreadPool::postTask<R>(...).
+    ///
+    /// While waiting, the caller runs other tasks from the pool instead of blocking idle.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::TaskFuture<int> result = threadPool.postTask<int>([](){ return 42; });
+    /// ...
+    /// int value = result.get();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    template <typename T>
+    class TaskFuture
+    {
+        std::shared_ptr<TaskFutureState<T>> state;
+
+    public:
+        using get_type = typename TaskFutureValue<T>::get_type;
+
+        TaskFuture()
+        {
+        }
+
+        TaskFuture(const std::shared_ptr<TaskFutureState<T>> &state)
+        {
+            this->state = state;
+        }
+
+        bool valid() const
+        {
+            return state != nullptr;
+        }
+
+        bool isReady() const
+        {
+            return state != nullptr && state->ready.load(std::memory_order_acquire);
+        }
+
+        // returns false if the current thread was interrupted before the task finished
+        bool wait()
+        {
+            ITK_ABORT(state == nullptr, "Trying to wait an invalid TaskFuture.\n");
+            return state->wait(false);
+        }
+
+        // waits the task completion (ignoring the thread interruption) and returns its result
+        get_type get()
+        {
+            ITK_ABORT(state == nullptr, "Trying to get an invalid TaskFuture.\n");
+            state->wait(true);
+            return state->storage.get();
+        }
+    };
+
+}
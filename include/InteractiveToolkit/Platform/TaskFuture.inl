@@ -0,0 +1,29 @@
+#pragma once
+
+#include "TaskFuture.h"
+#include "ThreadPool.h"
+
+namespace Platform
+{
+
+    template <typename T>
+    inline bool TaskFutureState<T>::wait(bool ignore_signal)
+    {
+        // help the pool while the task is not finished
+        while (!ready.load(std::memory_order_acquire))
+        {
+            if (pool == nullptr || !pool->runPendingTask())
+                break;
+        }
+
+        if (ready.load(std::memory_order_acquire))
+            return true;
+
+        if (!semaphore.blockingAcquire(ignore_signal))
+            return false;
+        // wake the next waiter
+        semaphore.release();
+        return true;
+    }
+
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "../common.h"
+#include "../EventCore/Callback.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "Semaphore.h"
+#include "ThreadPool.h"
+
+namespace Platform
+{
+
+    /// \brief Dependency graph of tasks executed in a ThreadPool.
+    ///
+    /// A task is posted only when all its predecessors finished, so no pool thread
+    /// stays blocked waiting for a join. When a task completes, the first successor
+    /// that becomes ready runs in the same thread, and the others are posted.
+    ///
+    /// The graph must be acyclic (run() aborts on a cycle) and cannot be modified while it is running.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::TaskGraph graph;
+    ///
+    /// auto cull = graph.addTask([](){ ... });
+    /// auto sort = graph.addTask([](){ ... });
+    /// auto build = graph.addTask([](){ ... });
+    ///
+    /// cull->precede(sort);
+    /// sort->precede(build);
+    ///
+    /// graph.run(&threadPool);
+    /// graph.wait();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class TaskGraph
+    {
+    public:
+        using CallbackType = typename EventCore::Callback<void()>;
+
+        class Node : public EventCore::HandleCallback
+        {
+            friend class TaskGraph;
+
+            TaskGraph *graph;
+            CallbackType task;
+            std::vector<Node *> successors;
+            uint32_t predecessor_count;
+            std::atomic<uint32_t> pending_predecessors;
+
+            void execute()
+            {
+                Node *node = this;
+                while (node != nullptr)
+                    node = node->runAndRelease();
+            }
+
+            // run the task and returns the first successor that became ready
+            Node *runAndRelease()
+            {
+                if (task)
+                    task();
+
+                Node *continuation = nullptr;
+                for (auto successor : successors)
+                {
+                    if (successor->pending_predecessors.fetch_sub(1) != 1)
+                        continue;
+                    if (continuation == nullptr)
+                        continuation = successor;
+                    else
+                        graph->pool->postTask(EventCore::CallbackWrapper(&Node::execute, successor));
+                }
+
+                graph->nodeDone();
+                return continuation;
+            }
+
+        public:
+            // deleted copy constructor and assign operator, to avoid copy...
+            Node(const Node &v) = delete;
+            Node &operator=(const Node &v) = delete;
+
+            Node(TaskGraph *graph, const CallbackType &task)
+            {
+                this->graph = graph;
+                this->task = task;
+                predecessor_count = 0;
+                pending_predecessors = 0;
+            }
+
+            // this node must finish before 'other' starts
+            Node *precede(Node *other)
+            {
+                ITK_ABORT(graph->isRunning(), "Trying to modify a running TaskGraph.\n");
+                ITK_ABORT(other->graph != graph, "Trying to link nodes from different TaskGraphs.\n");
+                successors.push_back(other);
+                other->predecessor_count++;
+                return this;
+            }
+
+            // 'other' must finish before this node starts
+            Node *succeed(Node *other)
+            {
+                other->precede(this);
+                return this;
+            }
+        };
+
+    private:
+        std::vector<Node *> nodes;
+        ThreadPool *pool;
+
+        std::atomic<uint32_t> pending_nodes;
+        Platform::Semaphore done_semaphore;
+
+        void nodeDone()
+        {
+            if (pending_nodes.fetch_sub(1) == 1)
+                done_semaphore.release();
+        }
+
+        // Kahn topological pass: a node in a cycle never gets
+        // all its predecessors released. Uses pending_predecessors as counters.
+        bool hasCycle()
+        {
+            std::vector<Node *> ready;
+            ready.reserve(nodes.size());
+            for (auto node : nodes)
+            {
+                node->pending_predecessors.store(node->predecessor_count, std::memory_order_relaxed);
+                if (node->predecessor_count == 0)
+                    ready.push_back(node);
+            }
+
+            size_t visited = 0;
+            while (ready.size() > 0)
+            {
+                Node *node = ready.back();
+                ready.pop_back();
+                visited++;
+                for (auto successor : node->successors)
+                {
+                    if (successor->pending_predecessors.fetch_sub(1, std::memory_order_relaxed) == 1)
+                        ready.push_back(successor);
+                }
+            }
+            return visited != nodes.size();
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        TaskGraph(const TaskGraph &v) = delete;
+        TaskGraph &operator=(const TaskGraph &v) = delete;
+
+        TaskGraph() : done_semaphore(0)
+        {
+            pool = nullptr;
+            pending_nodes = 0;
+        }
+
+        ~TaskGraph()
+        {
+            wait(true);
+            clear();
+        }
+
+        Node *addTask(const CallbackType &task)
+        {
+            ITK_ABORT(isRunning(), "Trying to modify a running TaskGraph.\n");
+            Node *node = new Node(this, task);
+            nodes.push_back(node);
+            return node;
+        }
+
+        void precede(Node *before, Node *after)
+        {
+            before->precede(after);
+        }
+
+        void clear()
+        {
+            ITK_ABORT(isRunning(), "Trying to clear a running TaskGraph.\n");
+            for (auto node : nodes)
+                delete node;
+            nodes.clear();
+        }
+
+        bool isRunning() const
+        {
+            return pending_nodes.load() > 0;
+        }
+
+        /// \brief Post the nodes without predecessors to the pool.
+        ///
+        /// The same graph can run again after wait() returns.
+        ///
+        void run(ThreadPool *pool)
+        {
+            ITK_ABORT(isRunning(), "Trying to run a TaskGraph that is already running.\n");
+            if (nodes.size() == 0)
+                return;
+
+            ITK_ABORT(hasCycle(), "TaskGraph with a cycle.\n");
+
+            this->pool = pool;
+            for (auto node : nodes)
+                node->pending_predecessors.store(node->predecessor_count, std::memory_order_relaxed);
+            pending_nodes.store((uint32_t)nodes.size());
+
+            for (auto node : nodes)
+            {
+                if (node->predecessor_count == 0)
+                    pool->postTask(EventCore::CallbackWrapper(&Node::execute, node));
+            }
+        }
+
+        /// \brief Wait all nodes to finish.
+        ///
+        /// The calling thread runs pending pool tasks while the graph is not complete.
+        ///
+        /// \return false if the current thread was interrupted before the graph finished
+        ///
+        bool wait(bool ignore_signal = false)
+        {
+            // not started or already waited
+            if (pool == nullptr)
+                return true;
+
+            while (isRunning())
+            {
+                if (!pool->runPendingTask())
+                    break;
+            }
+
+            if (!done_semaphore.blockingAcquire(ignore_signal))
+                return false;
+
+            pool = nullptr;
+            return true;
+        }
+    };
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "../common.h"
+#include "../EventCore/Callback.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "ThreadPool.h"
+#include "Core/Futex.h"
+
+namespace Platform
+{
+
+    class CancellationState
+    {
+    public:
+        std::atomic<bool> cancelled;
+        std::shared_ptr<CancellationState> parent;
+
+        // deleted copy constructor and assign operator, to avoid copy...
+        CancellationState(const CancellationState &v) = delete;
+        CancellationState &operator=(const CancellationState &v) = delete;
+
+        CancellationState(const std::shared_ptr<CancellationState> &parent)
+        {
+            cancelled = false;
+            this->parent = parent;
+        }
+
+        bool isCancelled()
+        {
+            if (cancelled.load(std::memory_order_relaxed))
+                return true;
+            if (parent != nullptr && parent->isCancelled())
+            {
+                // the next polls stop at this level
+                cancelled.store(true, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+    };
+
+    /// \brief Read side of a TaskGroup cancellation.
+    ///
+    /// Long-running tasks poll isCancelled() and return early.
+    /// The poll is a relaxed atomic load for each level of nested groups.
+    ///
+    /// A default constructed token is never cancelled.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class CancellationToken
+    {
+        std::shared_ptr<CancellationState> state;
+
+    public:
+        CancellationToken()
+        {
+        }
+
+        CancellationToken(const std::shared_ptr<CancellationState> &state)
+        {
+            this->state = state;
+        }
+
+        bool valid() const
+        {
+            return state != nullptr;
+        }
+
+        bool isCancelled() const
+        {
+            return state != nullptr && state->isCancelled();
+        }
+
+        const std::shared_ptr<CancellationState> &getState() const
+        {
+            return state;
+        }
+    };
+
+    /// \brief Set of tasks posted to a ThreadPool that can be waited and canceled together.
+    ///
+    /// cancel() does not stop the pool threads: the queued tasks of the group are
+    /// removed from the queue by the workers without running, and the running tasks
+    /// see the cancellation in their token.
+    ///
+    /// A group created with the token of another group is canceled with it.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::TaskGroup group(&threadPool);
+    /// Platform::CancellationToken token = group.getToken();
+    ///
+    /// for (int i = 0; i < batch_count; i++)
+    ///     group.run([i, token](){
+    ///         for (auto &path : batches[i]) {
+    ///             if (token.isCancelled())
+    ///                 return;
+    ///             findPath(path);
+    ///         }
+    ///     });
+    ///
+    /// // the user abandoned the job
+    /// group.cancel();
+    /// group.wait();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class TaskGroup : public EventCore::HandleCallback
+    {
+    public:
+        using CallbackType = typename EventCore::Callback<void()>;
+
+    private:
+        // shared with the posted tasks: the last task can still wake the
+        // waiters after the group is destroyed
+        struct Counters
+        {
+            std::atomic<uint32_t> pending_tasks;
+            std::atomic<uint32_t> waiters;
+
+            Counters()
+            {
+                pending_tasks = 0;
+                waiters = 0;
+            }
+
+            void taskDone()
+            {
+                if (pending_tasks.fetch_sub(1) == 1 && waiters.load() > 0)
+                    Futex::wakeAll(&pending_tasks);
+            }
+        };
+
+        ThreadPool *pool;
+        std::shared_ptr<CancellationState> state;
+        std::shared_ptr<Counters> counters;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        TaskGroup(const TaskGroup &v) = delete;
+        TaskGroup &operator=(const TaskGroup &v) = delete;
+
+        /// \brief Construct a group
+        ///
+        /// \param pool the pool that runs the tasks
+        /// \param parent when the parent token is canceled, this group is canceled too
+        ///
+        TaskGroup(ThreadPool *pool, const CancellationToken &parent = CancellationToken())
+        {
+            this->pool = pool;
+            state = std::make_shared<CancellationState>(parent.getState());
+            counters = std::make_shared<Counters>();
+        }
+
+        // the tasks usually reference data with the same lifetime of the group
+        ~TaskGroup()
+        {
+            wait(true);
+        }
+
+        /// \brief Post a task to the pool. It is skipped if the group is canceled before it starts.
+        ///
+        void run(const CallbackType &task)
+        {
+            counters->pending_tasks.fetch_add(1);
+            std::shared_ptr<CancellationState> state = this->state;
+            std::shared_ptr<Counters> counters = this->counters;
+            pool->postTask(CallbackType([state, counters, task]()
+                                        {
+                                            if (!state->isCancelled())
+                                                task();
+                                            counters->taskDone();
+                                        }));
+        }
+
+        void cancel()
+        {
+            state->cancelled.store(true, std::memory_order_relaxed);
+        }
+
+        bool isCancelled() const
+        {
+            return state->isCancelled();
+        }
+
+        CancellationToken getToken() const
+        {
+            return CancellationToken(state);
+        }
+
+        uint32_t pendingTasks() const
+        {
+            return counters->pending_tasks.load();
+        }
+
+        /// \brief Wait all tasks to finish (or to be skipped by the cancellation).
+        ///
+        /// The calling thread runs pending pool tasks while the group is not complete.
+        ///
+        /// \return false if the current thread was interrupted before the group finished
+        ///
+        bool wait(bool ignore_signal = false)
+        {
+            while (counters->pending_tasks.load() > 0)
+            {
+                if (!pool->runPendingTask())
+                    break;
+            }
+
+            while (true)
+            {
+                uint32_t pending = counters->pending_tasks.load();
+                if (pending == 0)
+                    return true;
+                counters->waiters.fetch_add(1);
+                FutexWaitResult result = Futex::waitInterruptible(&counters->pending_tasks, pending, UINT32_MAX, ignore_signal);
+                counters->waiters.fetch_sub(1);
+                if (result == FutexWaitResult::Interrupted)
+                    return false;
+            }
+        }
+    };
+
+}
@@ -37,6 +37,9 @@ namespace Platform
         std::condition_variable wait_cv;
         std::mutex wait_m;
 
+        std::mutex affinity_m;
+        std::vector<int32_t> affinity_cpus;
+
         void init()
         {
 #if defined(_WIN32)
@@ -99,6 +102,7 @@ namespace Platform
 
             // The Thread instance is stored in the user data
             Thread *owner = reinterpret_cast<Thread *>(userData);
+            owner->applyPendingAffinity();
             ThreadDataSet::Instance()->registerThread(owner);
             // Forward to the owner
             owner->runEntryPoint();
@@ -123,6 +127,7 @@ namespace Platform
             // Tell the thread to handle cancel requests immediately
             pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, nullptr);
 #endif
+            owner->applyPendingAffinity();
             ThreadDataSet::Instance()->registerThread(owner);
             // Forward to the owner
             owner->runEntryPoint();
@@ -191,7 +196,7 @@ namespace Platform
 #endif
         }
 
-        volatile bool interrupted;
+        std::atomic<bool> interrupted;
         volatile bool exited;
         volatile bool started;
         volatile bool shouldReleaseThreadID_byItself;
@@ -284,7 +289,7 @@ namespace Platform
         {
             Thread *thread = getCurrentThread();
             if (thread != nullptr)
-                return thread->interrupted;
+                return thread->interrupted.load(std::memory_order_acquire);
             return false;
         }
 
@@ -297,7 +302,7 @@ namespace Platform
         ///
         static ITK_INLINE Thread *getCurrentThread()
         {
-            Thread *result = ThreadDataSet::Instance()->getThreadByID(GetCurrentThreadId_Custom());
+            Thread *result = ThreadDataSet::currentThreadSlot();
             if (result == nullptr)
                 return Thread::getMainThread();
             return result;
@@ -900,7 +905,111 @@ namespace Platform
 #endif
         }
 
+        // affinity set before the thread start
+        void applyPendingAffinity()
+        {
+            std::lock_guard<decltype(perThreadData.affinity_m)> lock(perThreadData.affinity_m);
+            if (perThreadData.affinity_cpus.size() > 0)
+                setCurrentThreadAffinity(perThreadData.affinity_cpus);
+        }
+
+#if defined(_WIN32)
+        static bool setNativeThreadAffinity(HANDLE thread, const std::vector<int32_t> &cpus)
+        {
+            DWORD_PTR mask = 0;
+            for (int32_t cpu : cpus)
+                if (cpu >= 0 && cpu < (int32_t)(sizeof(DWORD_PTR) * 8))
+                    mask |= (DWORD_PTR)1 << cpu;
+            if (mask == 0)
+                return false;
+            return SetThreadAffinityMask(thread, mask) != 0;
+        }
+#elif defined(__linux__)
+        static bool setNativeThreadAffinity(pthread_t thread, const std::vector<int32_t> &cpus)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            int count = 0;
+            for (int32_t cpu : cpus)
+            {
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                {
+                    CPU_SET(cpu, &set);
+                    count++;
+                }
+            }
+            if (count == 0)
+                return false;
+            return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set) == 0;
+        }
+#endif
+
     public:
+        /// \brief Set the logical CPUs this thread can run on.
+        ///
+        /// If the thread is not started, the affinity is applied when it starts.
+        ///
+        /// The CPU ids are the same of the Platform::CPUTopology.
+        /// MacOS does not support thread affinity, and the call returns false.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// Platform::Thread thread( &thread_function );
+        /// // run in the first physical core
+        /// thread.setAffinity(Platform::CPUTopology::Instance()->cores[0]);
+        /// thread.start();
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        /// \return false if the affinity could not be applied
+        ///
+        bool setAffinity(const std::vector<int32_t> &cpus)
+        {
+#if defined(_WIN32) || defined(__linux__)
+            std::lock_guard<decltype(perThreadData.affinity_m)> lock(perThreadData.affinity_m);
+            perThreadData.affinity_cpus = cpus;
+
+            if (this == getCurrentThread())
+                return setCurrentThreadAffinity(cpus);
+            if (!isAlive())
+                return true;
+
+            return setNativeThreadAffinity(m_thread, cpus);
+#else
+            // no thread affinity support: nothing is stored to apply at the start
+            (void)cpus;
+            return false;
+#endif
+        }
+
+        bool setAffinity(int32_t cpu)
+        {
+            return setAffinity(std::vector<int32_t>{cpu});
+        }
+
+        std::vector<int32_t> getAffinity()
+        {
+            std::lock_guard<decltype(perThreadData.affinity_m)> lock(perThreadData.affinity_m);
+            return perThreadData.affinity_cpus;
+        }
+
+        /// \brief Set the logical CPUs the calling thread can run on.
+        ///
+        /// \author Alessandro Ribeiro
+        /// \return false if the affinity could not be applied
+        ///
+        static bool setCurrentThreadAffinity(const std::vector<int32_t> &cpus)
+        {
+#if defined(_WIN32)
+            return setNativeThreadAffinity(GetCurrentThread(), cpus);
+#elif defined(__linux__)
+            return setNativeThreadAffinity(pthread_self(), cpus);
+#else
+            return false;
+#endif
+        }
 
         static int QueryNumberOfSystemThreads()
         {
@@ -955,6 +1064,7 @@ namespace Platform
 }
 
 #include "Core/ThreadDataSet.inl"
+#include "Core/Futex.inl"
 #ifdef __APPLE__
 #include "Core/unamed_fake_sem.inl"
 #endif
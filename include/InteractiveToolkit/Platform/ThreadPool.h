@@ -1,83 +1,562 @@
 #pragma once
 
 #include "../EventCore/Callback.h"
+#include "../ITKCommon/Memory.h"
 #include "Core/ObjectQueue.h"
+#include "Core/SmartVector.h"
 #include "Thread.h"
+#include "CPUTopology.h"
+#include "TaskFuture.h"
+#include "ThreadPoolMetrics.h"
+
+// number of times a worker can pass over a lower priority lane with tasks before serving it once
+#ifndef ITK_THREADPOOL_STARVATION_LIMIT
+#define ITK_THREADPOOL_STARVATION_LIMIT 16
+#endif
 
 namespace Platform
 {
 
+    enum class ThreadPoolScheduler : uint8_t
+    {
+        // all workers dequeue from a single shared queue
+        SharedQueue,
+        // each worker owns a deque, idle workers steal from the others
+        WorkStealing
+    };
+
+    enum class ThreadPoolAffinity : uint8_t
+    {
+        // workers can run on any CPU
+        None,
+        // one worker per physical core (the first core is left to the calling thread)
+        PerCore,
+        // workers distributed round-robin over the NUMA nodes, each one can run on any CPU of its node
+        PerNumaNode
+    };
+
+    enum class ThreadPoolPriority : uint8_t
+    {
+        // latency critical: input handling, network replies
+        High = 0,
+        Normal = 1,
+        // bulk work: file loads, big sorts
+        Background = 2
+    };
+
+    /// \brief Pool of worker threads to run posted tasks.
+    ///
+    /// The tasks are posted to three lanes (ThreadPoolPriority). Optional reserved
+    /// workers run only High tasks, so the latency critical work does not wait
+    /// behind long bulk tasks that occupy all the general workers.
+    ///
+    /// When ITK_THREADPOOL_METRICS is defined, the pool records per worker busy/idle time,
+    /// steal counts and histograms of the queue wait and execution time of the tasks.
+    /// Use getMetrics() to take a snapshot. Without the define, the task path is
+    /// not changed and getMetrics() reports only the queue depth.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
     class ThreadPool : public EventCore::HandleCallback
     {
     public:
         using CallbackType = typename EventCore::Callback<void()>;
 
     private:
+        struct QueuedTask
+        {
+            CallbackType callback;
+#if defined(ITK_THREADPOOL_METRICS)
+            int64_t enqueue_us;
+#endif
+        };
+
+        struct WorkerQueue
+        {
+            Platform::Mutex mutex;
+            SmartVector<QueuedTask> tasks;
+        };
+
+        struct WorkerContext
+        {
+            ThreadPool *pool;
+            uint32_t index;
+            // consecutive tasks taken while the lower lane had tasks
+            uint32_t skipped_normal;
+            uint32_t skipped_background;
+        };
+
         std::vector<Platform::Thread *> threads;
-        Platform::ObjectQueue<CallbackType> tasks;
+        // number of workers created (threads is cleared by finish)
+        uint32_t worker_count;
+        // workers [general_worker_count, worker_count) run only High tasks
+        uint32_t general_worker_count;
 
         bool finish_all_tasks_before_finish;
+        ThreadPoolScheduler scheduler;
+        ThreadPoolAffinity affinity;
+
+        // FIFO of each priority. The Normal lane is used only by the SharedQueue scheduler,
+        // the WorkStealing scheduler keeps the Normal tasks in the worker deques.
+        WorkerQueue lanes[3];
+        std::atomic<uint32_t> lane_count[3];
+
+        // work stealing state
+        std::vector<WorkerQueue *> worker_queues;
+        Platform::Semaphore work_semaphore;
+        std::atomic<uint32_t> sleeping_workers;
+        std::atomic<uint32_t> round_robin;
+
+        // reserved high priority workers
+        Platform::Semaphore high_semaphore;
+        std::atomic<uint32_t> sleeping_high_workers;
+
+#if defined(ITK_THREADPOOL_METRICS)
+        ThreadPoolMetricsClock metrics_clock;
+        // one per worker, plus the last one for the threads outside the pool
+        ThreadPoolMetricsRecorder *metrics;
+        std::atomic<uint64_t> tasks_posted;
+#endif
+
+        // the worker (pool + index) that is running in the current thread
+        static ITK_INLINE WorkerContext *&currentWorker()
+        {
+            static thread_local WorkerContext *worker = nullptr;
+            return worker;
+        }
+
+        QueuedTask makeQueuedTask(const CallbackType &task)
+        {
+            QueuedTask result;
+            result.callback = task;
+#if defined(ITK_THREADPOOL_METRICS)
+            result.enqueue_us = metrics_clock.nowMicro();
+            tasks_posted.fetch_add(1, std::memory_order_relaxed);
+#endif
+            return result;
+        }
+
+        // metrics_index: worker index, or the thread count for threads outside the pool
+        void execute(QueuedTask &task, uint32_t metrics_index)
+        {
+#if defined(ITK_THREADPOOL_METRICS)
+            int64_t start_us = metrics_clock.nowMicro();
+            task.callback();
+            int64_t end_us = metrics_clock.nowMicro();
+            metrics[metrics_index].taskExecuted(
+                (start_us > task.enqueue_us) ? (uint64_t)(start_us - task.enqueue_us) : 0,
+                (end_us > start_us) ? (uint64_t)(end_us - start_us) : 0);
+#else
+            (void)metrics_index;
+            task.callback();
+#endif
+        }
+
+        uint32_t pendingTasks() const
+        {
+            return lane_count[0].load() + lane_count[1].load() + lane_count[2].load();
+        }
+
+        ITK_INLINE bool laneHasTasks(ThreadPoolPriority priority) const
+        {
+            return lane_count[(int)priority].load(std::memory_order_relaxed) > 0;
+        }
 
-        void run()
+        // FIFO from the front of a priority lane
+        bool popLaneTask(ThreadPoolPriority priority, QueuedTask *task)
         {
-            if (finish_all_tasks_before_finish)
+            if (lane_count[(int)priority].load() == 0)
+                return false;
+            WorkerQueue &queue = lanes[(int)priority];
+            Platform::AutoLock autoLock(&queue.mutex);
+            if (queue.tasks.size() == 0)
+                return false;
+            *task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            lane_count[(int)priority].fetch_sub(1);
+            return true;
+        }
+
+        // owner side: LIFO from the back of its own deque
+        bool popLocalTask(uint32_t index, QueuedTask *task)
+        {
+            WorkerQueue *queue = worker_queues[index];
+            Platform::AutoLock autoLock(&queue->mutex);
+            if (queue->tasks.size() == 0)
+                return false;
+            *task = std::move(queue->tasks.back());
+            queue->tasks.pop_back();
+            lane_count[(int)ThreadPoolPriority::Normal].fetch_sub(1);
+            return true;
+        }
+
+        // thief side: FIFO from the front of the victim deque
+        bool stealTask(uint32_t victim, QueuedTask *task)
+        {
+            WorkerQueue *queue = worker_queues[victim];
+            Platform::AutoLock autoLock(&queue->mutex);
+            if (queue->tasks.size() == 0)
+                return false;
+            *task = std::move(queue->tasks.front());
+            queue->tasks.pop_front();
+            lane_count[(int)ThreadPoolPriority::Normal].fetch_sub(1);
+            return true;
+        }
+
+        // index: general worker index, or UINT32_MAX for threads outside the pool
+        bool popNormalTask(uint32_t index, QueuedTask *task)
+        {
+            if (scheduler == ThreadPoolScheduler::SharedQueue)
+                return popLaneTask(ThreadPoolPriority::Normal, task);
+
+            if (lane_count[(int)ThreadPoolPriority::Normal].load() == 0)
+                return false;
+            uint32_t count = (uint32_t)worker_queues.size();
+            if (index == UINT32_MAX)
             {
-                bool value_not_readed = false;
-                while (!Platform::Thread::isCurrentThreadInterrupted() || tasks.size() > 0)
+                uint32_t start = round_robin.fetch_add(1, std::memory_order_relaxed);
+                for (uint32_t i = 0; i < count; i++)
                 {
-                    CallbackType task_callback = tasks.dequeue(&value_not_readed, true);
-                    if (value_not_readed)
-                        break;
-                    task_callback();
+                    if (stealTask((start + i) % count, task))
+                        return true;
                 }
+                return false;
             }
-            else
+
+            if (popLocalTask(index, task))
+                return true;
+            for (uint32_t i = 1; i < count; i++)
             {
-                bool is_signaled = false;
-                while (!Platform::Thread::isCurrentThreadInterrupted())
+                if (stealTask((index + i) % count, task))
                 {
-                    CallbackType task_callback = tasks.dequeue(&is_signaled);
-                    if (is_signaled)
+#if defined(ITK_THREADPOOL_METRICS)
+                    metrics[index].taskStolen();
+#endif
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // general workers: High before Normal before Background,
+        // but a lower lane passed over ITK_THREADPOOL_STARVATION_LIMIT times is served first
+        bool findTask(WorkerContext *context, QueuedTask *task)
+        {
+            if (pendingTasks() == 0)
+                return false;
+
+            if (context->skipped_background >= ITK_THREADPOOL_STARVATION_LIMIT &&
+                popLaneTask(ThreadPoolPriority::Background, task))
+            {
+                context->skipped_background = 0;
+                return true;
+            }
+
+            if (context->skipped_normal >= ITK_THREADPOOL_STARVATION_LIMIT &&
+                popNormalTask(context->index, task))
+            {
+                context->skipped_normal = 0;
+                if (laneHasTasks(ThreadPoolPriority::Background))
+                    context->skipped_background++;
+                return true;
+            }
+
+            if (popLaneTask(ThreadPoolPriority::High, task))
+            {
+                if (laneHasTasks(ThreadPoolPriority::Normal))
+                    context->skipped_normal++;
+                if (laneHasTasks(ThreadPoolPriority::Background))
+                    context->skipped_background++;
+                return true;
+            }
+
+            if (popNormalTask(context->index, task))
+            {
+                context->skipped_normal = 0;
+                if (laneHasTasks(ThreadPoolPriority::Background))
+                    context->skipped_background++;
+                return true;
+            }
+
+            if (popLaneTask(ThreadPoolPriority::Background, task))
+            {
+                context->skipped_background = 0;
+                return true;
+            }
+            return false;
+        }
+
+        // used by threads that are not workers of this pool: strict priority order
+        bool findAnyTask(QueuedTask *task)
+        {
+            return popLaneTask(ThreadPoolPriority::High, task) ||
+                   popNormalTask(UINT32_MAX, task) ||
+                   popLaneTask(ThreadPoolPriority::Background, task);
+        }
+
+        void runWorker(uint32_t index)
+        {
+            WorkerContext context;
+            context.pool = this;
+            context.index = index;
+            context.skipped_normal = 0;
+            context.skipped_background = 0;
+            currentWorker() = &context;
+#if defined(ITK_THREADPOOL_METRICS)
+            metrics[index].workerStart(metrics_clock.nowMicro());
+#endif
+
+            bool reserved = index >= general_worker_count;
+            Platform::Semaphore &semaphore = (reserved) ? high_semaphore : work_semaphore;
+            std::atomic<uint32_t> &sleeping = (reserved) ? sleeping_high_workers : sleeping_workers;
+
+            QueuedTask task;
+            while (true)
+            {
+                if (!finish_all_tasks_before_finish && Platform::Thread::isCurrentThreadInterrupted())
+                    break;
+
+                bool found = (reserved) ? popLaneTask(ThreadPoolPriority::High, &task) : findTask(&context, &task);
+                if (found)
+                {
+                    execute(task, index);
+                    task.callback = CallbackType();
+                    continue;
+                }
+
+                uint32_t available = (reserved) ? lane_count[(int)ThreadPoolPriority::High].load() : pendingTasks();
+
+                if (Platform::Thread::isCurrentThreadInterrupted())
+                {
+                    if (available == 0)
                         break;
-                    task_callback();
+                    // a task is being pushed right now
+                    Platform::Sleep::yield();
+                    continue;
+                }
+
+                // announce the sleep before the last check,
+                // so postTask either sees the sleeper or we see the task
+                sleeping.fetch_add(1);
+                available = (reserved) ? lane_count[(int)ThreadPoolPriority::High].load() : pendingTasks();
+                if (available > 0)
+                {
+                    sleeping.fetch_sub(1);
+                    continue;
                 }
+                semaphore.blockingAcquire();
+                sleeping.fetch_sub(1);
             }
+
+#if defined(ITK_THREADPOOL_METRICS)
+            metrics[index].workerStop(metrics_clock.nowMicro());
+#endif
+            currentWorker() = nullptr;
         }
 
     public:
-        ThreadPool(int count = -1, bool finish_all_tasks_before_finish = true)
+        /// \brief Construct the pool
+        ///
+        /// \param count number of workers (-1: number of CPU threads - 1)
+        /// \param finish_all_tasks_before_finish if true, finish() waits the queued tasks to run
+        /// \param scheduler how the Normal tasks are distributed to the workers
+        /// \param affinity CPU placement of the workers
+        /// \param reserved_high_priority_workers extra workers that run only High tasks (no affinity)
+        ///
+        ThreadPool(int count = -1, bool finish_all_tasks_before_finish = true,
+                   ThreadPoolScheduler scheduler = ThreadPoolScheduler::SharedQueue,
+                   ThreadPoolAffinity affinity = ThreadPoolAffinity::None,
+                   int reserved_high_priority_workers = 0) : work_semaphore(0), high_semaphore(0)
         {
             this->finish_all_tasks_before_finish = finish_all_tasks_before_finish;
+            this->scheduler = scheduler;
+            this->affinity = affinity;
+            for (int i = 0; i < 3; i++)
+                lane_count[i] = 0;
+            sleeping_workers = 0;
+            sleeping_high_workers = 0;
+            round_robin = 0;
+#if defined(ITK_THREADPOOL_METRICS)
+            tasks_posted = 0;
+#endif
+
+            CPUTopology *topology = CPUTopology::Instance();
+
             // avoid lock entire OS
             if (count == -1)
-                count = Platform::Thread::QueryNumberOfSystemThreads() - 1;
+            {
+                if (affinity == ThreadPoolAffinity::PerCore)
+                    count = (int)topology->cores.size() - 1;
+                else
+                    count = Platform::Thread::QueryNumberOfSystemThreads() - 1;
+            }
             if (count <= 0)
                 count = 1;
+            if (reserved_high_priority_workers < 0)
+                reserved_high_priority_workers = 0;
+            general_worker_count = (uint32_t)count;
+            worker_count = (uint32_t)(count + reserved_high_priority_workers);
+
+#if defined(ITK_THREADPOOL_METRICS)
+            // cache aligned (the C++11 new does not respect alignas)
+            metrics = (ThreadPoolMetricsRecorder *)ITKCommon::Memory::malloc(sizeof(ThreadPoolMetricsRecorder) * (worker_count + 1), ITK_CACHE_LINE_SIZE);
+            for (uint32_t i = 0; i <= worker_count; i++)
+                new (&metrics[i]) ThreadPoolMetricsRecorder();
+#endif
 
-            for (int i = 0; i < count; i++)
+            if (scheduler == ThreadPoolScheduler::WorkStealing)
             {
-                Platform::Thread *thread = new Platform::Thread(
-                    EventCore::CallbackWrapper(&ThreadPool::run, this));
+                for (int i = 0; i < count; i++)
+                    worker_queues.push_back(new WorkerQueue());
+            }
+
+            for (uint32_t i = 0; i < worker_count; i++)
+            {
+                uint32_t index = i;
+                Platform::Thread *thread = new Platform::Thread([this, index]()
+                                                                { runWorker(index); });
+
+                if (index < general_worker_count)
+                {
+                    if (affinity == ThreadPoolAffinity::PerCore)
+                        thread->setAffinity(topology->cores[(i + 1) % topology->cores.size()]);
+                    else if (affinity == ThreadPoolAffinity::PerNumaNode)
+                        thread->setAffinity(topology->numa_nodes[i % topology->numa_nodes.size()]);
+                }
+
                 threads.push_back(thread);
                 thread->start();
             }
 
-            printf("ThreadPool created with: %i threads\n", count);
+            if (reserved_high_priority_workers > 0)
+                printf("ThreadPool created with: %i threads (+%i high priority)\n", count, reserved_high_priority_workers);
+            else
+                printf("ThreadPool created with: %i threads\n", count);
         }
 
         ~ThreadPool()
         {
             finish();
+
+            for (auto queue : worker_queues)
+                delete queue;
+            worker_queues.clear();
+
+#if defined(ITK_THREADPOOL_METRICS)
+            for (uint32_t i = 0; i <= worker_count; i++)
+                metrics[i].~ThreadPoolMetricsRecorder();
+            ITKCommon::Memory::free(metrics);
+            metrics = nullptr;
+#endif
         }
 
-        void postTask(const CallbackType &task)
+        /// \brief Post a task to the lane of its priority.
+        ///
+        /// High tasks run before the queued Normal tasks, and Normal before Background.
+        /// A worker that passed over a lower lane ITK_THREADPOOL_STARVATION_LIMIT times
+        /// serves it once, so Background tasks progress under a constant High load.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// threadPool.postTask([](){ replyToClient(); }, Platform::ThreadPoolPriority::High);
+        /// threadPool.postTask([](){ loadTexture(); }, Platform::ThreadPoolPriority::Background);
+        /// \endcode
+        ///
+        void postTask(const CallbackType &task, ThreadPoolPriority priority = ThreadPoolPriority::Normal)
         {
-            tasks.enqueue(task);
+            if (priority == ThreadPoolPriority::Normal && scheduler == ThreadPoolScheduler::WorkStealing)
+            {
+                // tasks posted from a worker of this pool stay in its local deque
+                WorkerContext *worker = currentWorker();
+                uint32_t target;
+                if (worker != nullptr && worker->pool == this && worker->index < general_worker_count)
+                    target = worker->index;
+                else
+                    target = round_robin.fetch_add(1, std::memory_order_relaxed) % (uint32_t)worker_queues.size();
+
+                WorkerQueue *queue = worker_queues[target];
+                {
+                    Platform::AutoLock autoLock(&queue->mutex);
+                    queue->tasks.push_back(makeQueuedTask(task));
+                }
+            }
+            else
+            {
+                WorkerQueue &queue = lanes[(int)priority];
+                Platform::AutoLock autoLock(&queue.mutex);
+                queue.tasks.push_back(makeQueuedTask(task));
+            }
+            lane_count[(int)priority].fetch_add(1);
+
+            if (priority == ThreadPoolPriority::High && sleeping_high_workers.load() > 0)
+                high_semaphore.release();
+            else if (sleeping_workers.load() > 0)
+                work_semaphore.release();
+        }
+
+        /// \brief Post a task and get a TaskFuture to wait for its result.
+        ///
+        /// The return type must be explicit, so lambdas keep using the void postTask by default.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// Platform::TaskFuture<int> result = threadPool.postTask<int>([](){ return 42; });
+        /// Platform::TaskFuture<void> done = threadPool.postTask<void>([](){ ... });
+        /// done.wait();
+        /// \endcode
+        ///
+        template <typename R>
+        TaskFuture<R> postTask(const EventCore::Callback<R()> &task, ThreadPoolPriority priority = ThreadPoolPriority::Normal)
+        {
+            std::shared_ptr<TaskFutureState<R>> state = std::make_shared<TaskFutureState<R>>(this);
+            postTask(CallbackType([state, task]()
+                                  { state->run(task); }),
+                     priority);
+            return TaskFuture<R>(state);
+        }
+
+        /// \brief Run one queued task in the calling thread, if there is any.
+        ///
+        /// Useful to help the pool while waiting for posted work,
+        /// instead of blocking the current thread idle.
+        ///
+        /// \return true if a task was executed
+        ///
+        bool runPendingTask()
+        {
+            QueuedTask task;
+            // tasks run by threads outside the pool use the last metrics slot
+            uint32_t metrics_index = worker_count;
+            WorkerContext *worker = currentWorker();
+            bool found;
+            if (worker != nullptr && worker->pool == this)
+            {
+                metrics_index = worker->index;
+                if (worker->index < general_worker_count)
+                    found = findTask(worker, &task);
+                else
+                    found = popLaneTask(ThreadPoolPriority::High, &task);
+            }
+            else
+                found = findAnyTask(&task);
+            if (!found)
+                return false;
+            execute(task, metrics_index);
+            return true;
         }
 
         uint32_t taskInQueue()
         {
-            return tasks.size();
+            return pendingTasks();
+        }
+
+        uint32_t taskInQueue(ThreadPoolPriority priority)
+        {
+            return lane_count[(int)priority].load();
         }
 
         void finish()
@@ -96,6 +575,53 @@ namespace Platform
         {
             return (int)threads.size();
         }
+
+        /// \brief Snapshot of the runtime metrics.
+        ///
+        /// The counters are read with relaxed loads while the workers are running,
+        /// so the fields of a snapshot can be a few tasks apart from each other.
+        ///
+        /// Example:
+        ///
+        /// \code
+        ///
+        /// Platform::ThreadPoolMetrics metrics = threadPool.getMetrics();
+        /// printf("queue: %u p99 wait: %llu us\n",
+        ///        metrics.queue_depth,
+        ///        (unsigned long long)metrics.total.queue_wait_us.percentile(0.99));
+        /// \endcode
+        ///
+        ThreadPoolMetrics getMetrics()
+        {
+            ThreadPoolMetrics result;
+            result.queue_depth = taskInQueue();
+#if defined(ITK_THREADPOOL_METRICS)
+            result.enabled = true;
+            result.tasks_posted = tasks_posted.load(std::memory_order_relaxed);
+            int64_t now_us = metrics_clock.nowMicro();
+            result.workers.resize(worker_count);
+            for (uint32_t i = 0; i < worker_count; i++)
+            {
+                metrics[i].copyTo(&result.workers[i], now_us);
+                result.total.merge(result.workers[i]);
+            }
+            metrics[worker_count].copyTo(&result.external, now_us);
+            result.total.merge(result.external);
+#endif
+            return result;
+        }
+
+        ThreadPoolScheduler getScheduler() const
+        {
+            return scheduler;
+        }
+
+        ThreadPoolAffinity getAffinity() const
+        {
+            return affinity;
+        }
     };
 
 }
+
+#include "TaskFuture.inl"
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "../common.h"
+#include "Time.h"
+
+// number of log2 buckets of the latency histograms (the last one is unbounded)
+#ifndef ITK_THREADPOOL_HISTOGRAM_BUCKETS
+#define ITK_THREADPOOL_HISTOGRAM_BUCKETS 32
+#endif
+
+namespace Platform
+{
+
+    /// \brief Latency histogram with log2 buckets in microseconds.
+    ///
+    /// The bucket 0 counts the samples below 1us, the bucket i counts the samples
+    /// in the range [2^(i-1), 2^i) us. The last bucket has no upper bound.
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    struct ThreadPoolHistogram
+    {
+        uint64_t buckets[ITK_THREADPOOL_HISTOGRAM_BUCKETS];
+        uint64_t count;
+        uint64_t sum_us;
+        uint64_t max_us;
+
+        ThreadPoolHistogram()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            memset(buckets, 0, sizeof(buckets));
+            count = 0;
+            sum_us = 0;
+            max_us = 0;
+        }
+
+        void merge(const ThreadPoolHistogram &v)
+        {
+            for (int i = 0; i < ITK_THREADPOOL_HISTOGRAM_BUCKETS; i++)
+                buckets[i] += v.buckets[i];
+            count += v.count;
+            sum_us += v.sum_us;
+            if (v.max_us > max_us)
+                max_us = v.max_us;
+        }
+
+        uint64_t average() const
+        {
+            if (count == 0)
+                return 0;
+            return sum_us / count;
+        }
+
+        /// \brief Upper bound of the bucket that contains the percentile
+        ///
+        /// \param p percentile in the range [0, 1]
+        /// \return time in microseconds (max_us for the last bucket)
+        ///
+        uint64_t percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+            uint64_t target = (uint64_t)(p * (double)count + 0.5);
+            if (target == 0)
+                target = 1;
+            uint64_t accumulated = 0;
+            for (int i = 0; i < ITK_THREADPOOL_HISTOGRAM_BUCKETS - 1; i++)
+            {
+                accumulated += buckets[i];
+                if (accumulated >= target)
+                {
+                    uint64_t upper = UINT64_C(1) << i;
+                    return (upper < max_us) ? upper : max_us;
+                }
+            }
+            return max_us;
+        }
+
+        static ITK_INLINE uint32_t bucketIndex(uint64_t us)
+        {
+            uint32_t index = 0;
+            while (us != 0 && index < (uint32_t)(ITK_THREADPOOL_HISTOGRAM_BUCKETS - 1))
+            {
+                us >>= 1;
+                index++;
+            }
+            return index;
+        }
+    };
+
+    /// \brief Counters of one worker thread.
+    ///
+    /// The tasks executed by threads that are not workers of the pool
+    /// (ThreadPool::runPendingTask) are counted in ThreadPoolMetrics::external.
+    ///
+    struct ThreadPoolWorkerMetrics
+    {
+        // time running tasks
+        uint64_t busy_us;
+        // time alive and not running tasks (waiting or searching for work)
+        uint64_t idle_us;
+        uint64_t tasks_executed;
+        // tasks taken from the deque of another worker (ThreadPoolScheduler::WorkStealing)
+        uint64_t steal_count;
+        // time between postTask and the start of the task
+        ThreadPoolHistogram queue_wait_us;
+        // task execution time
+        ThreadPoolHistogram execution_us;
+
+        ThreadPoolWorkerMetrics()
+        {
+            busy_us = 0;
+            idle_us = 0;
+            tasks_executed = 0;
+            steal_count = 0;
+        }
+
+        void merge(const ThreadPoolWorkerMetrics &v)
+        {
+            busy_us += v.busy_us;
+            idle_us += v.idle_us;
+            tasks_executed += v.tasks_executed;
+            steal_count += v.steal_count;
+            queue_wait_us.merge(v.queue_wait_us);
+            execution_us.merge(v.execution_us);
+        }
+    };
+
+    /// \brief Snapshot of the ThreadPool runtime metrics.
+    ///
+    /// The counters are cumulative since the pool creation.
+    /// Compare two snapshots to get the rates of an interval.
+    ///
+    /// Only queue_depth is filled when the library is built without ITK_THREADPOOL_METRICS.
+    ///
+    struct ThreadPoolMetrics
+    {
+        // false when built without ITK_THREADPOOL_METRICS
+        bool enabled;
+        uint32_t queue_depth;
+        uint64_t tasks_posted;
+        std::vector<ThreadPoolWorkerMetrics> workers;
+        ThreadPoolWorkerMetrics external;
+        // sum of the workers and external
+        ThreadPoolWorkerMetrics total;
+
+        ThreadPoolMetrics()
+        {
+            enabled = false;
+            queue_depth = 0;
+            tasks_posted = 0;
+        }
+    };
+
+#if defined(ITK_THREADPOOL_METRICS)
+
+    // relaxed counters written by the running threads (one cache line set per worker)
+    class alignas(ITK_CACHE_LINE_SIZE) ThreadPoolMetricsRecorder
+    {
+        struct Histogram
+        {
+            std::atomic<uint64_t> buckets[ITK_THREADPOOL_HISTOGRAM_BUCKETS];
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> sum_us;
+            std::atomic<uint64_t> max_us;
+
+            Histogram()
+            {
+                for (int i = 0; i < ITK_THREADPOOL_HISTOGRAM_BUCKETS; i++)
+                    buckets[i] = 0;
+                count = 0;
+                sum_us = 0;
+                max_us = 0;
+            }
+
+            void add(uint64_t us)
+            {
+                buckets[ThreadPoolHistogram::bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+                count.fetch_add(1, std::memory_order_relaxed);
+                sum_us.fetch_add(us, std::memory_order_relaxed);
+                uint64_t current_max = max_us.load(std::memory_order_relaxed);
+                while (us > current_max &&
+                       !max_us.compare_exchange_weak(current_max, us, std::memory_order_relaxed))
+                {
+                }
+            }
+
+            void copyTo(ThreadPoolHistogram *out) const
+            {
+                for (int i = 0; i < ITK_THREADPOOL_HISTOGRAM_BUCKETS; i++)
+                    out->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+                out->count = count.load(std::memory_order_relaxed);
+                out->sum_us = sum_us.load(std::memory_order_relaxed);
+                out->max_us = max_us.load(std::memory_order_relaxed);
+            }
+        };
+
+        std::atomic<uint64_t> busy_us;
+        std::atomic<uint64_t> tasks_executed;
+        std::atomic<uint64_t> steal_count;
+        // worker lifetime, -1 while not started/running
+        std::atomic<int64_t> start_us;
+        std::atomic<int64_t> stop_us;
+        Histogram queue_wait_us;
+        Histogram execution_us;
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        ThreadPoolMetricsRecorder(const ThreadPoolMetricsRecorder &v) = delete;
+        ThreadPoolMetricsRecorder &operator=(const ThreadPoolMetricsRecorder &v) = delete;
+
+        ThreadPoolMetricsRecorder()
+        {
+            busy_us = 0;
+            tasks_executed = 0;
+            steal_count = 0;
+            start_us = -1;
+            stop_us = -1;
+        }
+
+        void workerStart(int64_t now_us)
+        {
+            start_us.store(now_us, std::memory_order_relaxed);
+        }
+
+        void workerStop(int64_t now_us)
+        {
+            stop_us.store(now_us, std::memory_order_relaxed);
+        }
+
+        void taskExecuted(uint64_t wait_us, uint64_t exec_us)
+        {
+            queue_wait_us.add(wait_us);
+            execution_us.add(exec_us);
+            busy_us.fetch_add(exec_us, std::memory_order_relaxed);
+            tasks_executed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void taskStolen()
+        {
+            steal_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void copyTo(ThreadPoolWorkerMetrics *out, int64_t now_us) const
+        {
+            out->busy_us = busy_us.load(std::memory_order_relaxed);
+            out->tasks_executed = tasks_executed.load(std::memory_order_relaxed);
+            out->steal_count = steal_count.load(std::memory_order_relaxed);
+            queue_wait_us.copyTo(&out->queue_wait_us);
+            execution_us.copyTo(&out->execution_us);
+
+            out->idle_us = 0;
+            int64_t start = start_us.load(std::memory_order_relaxed);
+            if (start >= 0)
+            {
+                int64_t stop = stop_us.load(std::memory_order_relaxed);
+                if (stop < 0)
+                    stop = now_us;
+                uint64_t alive_us = (stop > start) ? (uint64_t)(stop - start) : 0;
+                if (alive_us > out->busy_us)
+                    out->idle_us = alive_us - out->busy_us;
+            }
+        }
+    };
+
+    // monotonic microseconds shared by all threads of the pool (never reset)
+    class ThreadPoolMetricsClock
+    {
+#if defined(_WIN32)
+        w32PerformanceCounter counter;
+#else
+        UnixMicroCounter counter;
+#endif
+    public:
+        int64_t nowMicro()
+        {
+#if defined(_WIN32)
+            return counter.GetCounterMicro(false);
+#else
+            return counter.GetDeltaMicro(false);
+#endif
+        }
+    };
+
+#endif
+
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include "../common.h"
+#include "../EventCore/Callback.h"
+#include "../ITKCommon/ITKAbort.h"
+#include "Mutex.h"
+#include "AutoLock.h"
+#include "Condition.h"
+#include "Thread.h"
+#include "ThreadPool.h"
+#include "Time.h"
+
+namespace Platform
+{
+
+    struct TimerHandle
+    {
+        uint32_t index;
+        uint32_t generation;
+
+        TimerHandle()
+        {
+            index = UINT32_MAX;
+            generation = 0;
+        }
+
+        bool valid() const
+        {
+            return index != UINT32_MAX;
+        }
+    };
+
+    /// \brief Hierarchical timer wheel that runs delayed and periodic tasks.
+    ///
+    /// Timers are kept in 4 levels of slots (256, 64, 64 and 64 slots). Insert and cancel
+    /// are O(1): the timer is linked into the slot of its expiration tick. Far timers are
+    /// moved to a lower level when the wheel reaches their slot.
+    ///
+    /// One timing thread advances the wheel using the monotonic counter and hands the
+    /// expired callbacks to a ThreadPool (or runs them itself when there is no pool).
+    /// It sleeps until the next non-empty slot, and stays parked when there is no timer.
+    ///
+    /// A periodic callback is posted again each period, even if the previous execution
+    /// in the pool did not finish. Cancel does not wait a callback already posted to the pool.
+    ///
+    /// Example:
+    ///
+    /// \code
+    ///
+    /// Platform::ThreadPool threadPool;
+    /// Platform::TimerWheel timers(&threadPool);
+    ///
+    /// Platform::TimerHandle timeout = timers.postDelayed(5000, [](){ printf("read timeout\n"); });
+    /// Platform::TimerHandle heartbeat = timers.postPeriodic(1000, [](){ printf("heartbeat\n"); });
+    /// ...
+    /// timers.cancel(timeout);
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    class TimerWheel : public EventCore::HandleCallback
+    {
+    public:
+        using CallbackType = typename EventCore::Callback<void()>;
+
+    private:
+        static const uint32_t LEVEL0_BITS = 8;
+        static const uint32_t LEVELN_BITS = 6;
+        static const uint32_t LEVEL0_SIZE = 1 << LEVEL0_BITS;
+        static const uint32_t LEVELN_SIZE = 1 << LEVELN_BITS;
+        static const uint32_t LEVEL_COUNT = 4;
+        static const uint32_t SLOT_COUNT = LEVEL0_SIZE + LEVELN_SIZE * (LEVEL_COUNT - 1);
+        // max distance (in ticks) a timer can be placed in the wheel
+        static const uint64_t MAX_RANGE = UINT64_C(1) << (LEVEL0_BITS + LEVELN_BITS * (LEVEL_COUNT - 1));
+        static const uint32_t NONE = UINT32_MAX;
+
+        struct TimerNode
+        {
+            uint64_t expires;
+            uint64_t period_ticks;
+            uint32_t prev;
+            uint32_t next;
+            uint32_t slot;
+            uint32_t generation;
+            bool active;
+            CallbackType callback;
+        };
+
+        std::vector<TimerNode> nodes;
+        std::vector<uint32_t> free_nodes;
+        uint32_t slots[SLOT_COUNT];
+        uint32_t active_count;
+
+        uint64_t tick_us;
+        uint64_t current_tick;
+        // tick the timing thread will wake up, UINT64_MAX when parked without timeout
+        uint64_t next_wake_tick;
+
+#if defined(_WIN32)
+        w32PerformanceCounter counter;
+#else
+        UnixMicroCounter counter;
+#endif
+
+        ThreadPool *pool;
+        Platform::Mutex mutex;
+        Platform::Condition condition;
+        Platform::Thread *thread;
+
+        int64_t elapsedMicro()
+        {
+#if defined(_WIN32)
+            return counter.GetCounterMicro(false);
+#else
+            return counter.GetDeltaMicro(false);
+#endif
+        }
+
+        uint64_t nowTick()
+        {
+            return (uint64_t)elapsedMicro() / tick_us;
+        }
+
+        uint32_t slotFor(uint64_t expires)
+        {
+            uint64_t delta;
+            if (expires <= current_tick)
+            {
+                // late timer: fire in the next tick
+                expires = current_tick + 1;
+                delta = 1;
+            }
+            else
+                delta = expires - current_tick;
+
+            if (delta >= MAX_RANGE)
+            {
+                // it is moved down when the wheel reaches the slot
+                expires = current_tick + MAX_RANGE - 1;
+                delta = MAX_RANGE - 1;
+            }
+
+            if (delta < LEVEL0_SIZE)
+                return (uint32_t)(expires & (LEVEL0_SIZE - 1));
+
+            uint32_t shift = LEVEL0_BITS;
+            for (uint32_t level = 1; level < LEVEL_COUNT; level++)
+            {
+                if (delta < (UINT64_C(1) << (shift + LEVELN_BITS)) || level == LEVEL_COUNT - 1)
+                    return LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + (uint32_t)((expires >> shift) & (LEVELN_SIZE - 1));
+                shift += LEVELN_BITS;
+            }
+            return 0;
+        }
+
+        void link(uint32_t index)
+        {
+            TimerNode &node = nodes[index];
+            uint32_t slot = slotFor(node.expires);
+            node.slot = slot;
+            node.prev = NONE;
+            node.next = slots[slot];
+            if (slots[slot] != NONE)
+                nodes[slots[slot]].prev = index;
+            slots[slot] = index;
+        }
+
+        void unlink(uint32_t index)
+        {
+            TimerNode &node = nodes[index];
+            if (node.prev != NONE)
+                nodes[node.prev].next = node.next;
+            else
+                slots[node.slot] = node.next;
+            if (node.next != NONE)
+                nodes[node.next].prev = node.prev;
+            node.prev = NONE;
+            node.next = NONE;
+        }
+
+        void freeNode(uint32_t index)
+        {
+            TimerNode &node = nodes[index];
+            node.active = false;
+            node.generation++;
+            node.callback = CallbackType();
+            free_nodes.push_back(index);
+            active_count--;
+        }
+
+        // hand the callback to the expired list, and re-insert the periodic timer
+        void expire(uint32_t index, std::vector<CallbackType> *expired)
+        {
+            TimerNode &node = nodes[index];
+            expired->push_back(node.callback);
+            if (node.period_ticks > 0)
+            {
+                node.expires += node.period_ticks;
+                link(index);
+            }
+            else
+                freeNode(index);
+        }
+
+        // re-insert all timers of a slot, relative to the current tick
+        void cascade(uint32_t slot, std::vector<CallbackType> *expired)
+        {
+            uint32_t index = slots[slot];
+            slots[slot] = NONE;
+            while (index != NONE)
+            {
+                uint32_t next = nodes[index].next;
+                // a timer that expires in this tick would be linked as late (next tick)
+                if (nodes[index].expires <= current_tick)
+                    expire(index, expired);
+                else
+                    link(index);
+                index = next;
+            }
+        }
+
+        // without timers the slots are empty: move the wheel straight
+        // to the current time instead of advancing one tick at a time
+        void skipIdleTicks()
+        {
+            if (active_count != 0)
+                return;
+            uint64_t now = nowTick();
+            if (now > current_tick)
+                current_tick = now;
+        }
+
+        void advanceTick(std::vector<CallbackType> *expired)
+        {
+            current_tick++;
+
+            // move the timers of the upper levels that reached their slot
+            uint32_t shift = LEVEL0_BITS;
+            for (uint32_t level = 1; level < LEVEL_COUNT; level++)
+            {
+                if ((current_tick & ((UINT64_C(1) << shift) - 1)) != 0)
+                    break;
+                cascade(LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + (uint32_t)((current_tick >> shift) & (LEVELN_SIZE - 1)), expired);
+                shift += LEVELN_BITS;
+            }
+
+            uint32_t slot = (uint32_t)(current_tick & (LEVEL0_SIZE - 1));
+            uint32_t index = slots[slot];
+            slots[slot] = NONE;
+            while (index != NONE)
+            {
+                uint32_t next = nodes[index].next;
+                if (nodes[index].expires > current_tick)
+                    link(index);
+                else
+                    expire(index, expired);
+                index = next;
+            }
+        }
+
+        // ticks until the next non-empty level 0 slot (or the next cascade)
+        uint64_t ticksToNextEvent()
+        {
+            uint64_t tick = current_tick + 1;
+            while (true)
+            {
+                if (slots[tick & (LEVEL0_SIZE - 1)] != NONE)
+                    return tick - current_tick;
+                if ((tick & (LEVEL0_SIZE - 1)) == 0)
+                    return tick - current_tick;
+                tick++;
+            }
+        }
+
+        void run()
+        {
+            std::vector<CallbackType> expired;
+            mutex.lock();
+            while (!Platform::Thread::isCurrentThreadInterrupted())
+            {
+                skipIdleTicks();
+                uint64_t now = nowTick();
+                while (current_tick < now)
+                    advanceTick(&expired);
+
+                if (expired.size() > 0)
+                {
+                    mutex.unlock();
+                    for (auto &callback : expired)
+                    {
+                        if (pool != nullptr)
+                            pool->postTask(callback);
+                        else
+                            callback();
+                    }
+                    expired.clear();
+                    mutex.lock();
+                    continue;
+                }
+
+                bool signaled = false;
+                if (active_count == 0)
+                {
+                    next_wake_tick = UINT64_MAX;
+                    condition.wait(&mutex, &signaled);
+                }
+                else
+                {
+                    next_wake_tick = current_tick + ticksToNextEvent();
+                    int64_t wait_us = (int64_t)(next_wake_tick * tick_us) - elapsedMicro();
+                    if (wait_us > 0)
+                        condition.wait_for(&mutex, (uint32_t)((wait_us + 999) / 1000), &signaled);
+                }
+                if (signaled)
+                    break;
+            }
+            next_wake_tick = UINT64_MAX;
+            mutex.unlock();
+        }
+
+        TimerHandle add(uint32_t delay_ms, uint32_t period_ms, const CallbackType &callback)
+        {
+            uint64_t delay_us = (uint64_t)delay_ms * UINT64_C(1000);
+            uint64_t period_ticks = ((uint64_t)period_ms * UINT64_C(1000) + tick_us - 1) / tick_us;
+            if (period_ms > 0 && period_ticks == 0)
+                period_ticks = 1;
+
+            Platform::AutoLock autoLock(&mutex);
+
+            uint32_t index;
+            if (free_nodes.size() > 0)
+            {
+                index = free_nodes.back();
+                free_nodes.pop_back();
+            }
+            else
+            {
+                index = (uint32_t)nodes.size();
+                nodes.push_back(TimerNode());
+                nodes[index].generation = 0;
+            }
+
+            // the timing thread does not advance an empty wheel while parked
+            skipIdleTicks();
+
+            TimerNode &node = nodes[index];
+            node.expires = ((uint64_t)elapsedMicro() + delay_us + tick_us - 1) / tick_us;
+            node.period_ticks = period_ticks;
+            node.active = true;
+            node.callback = callback;
+            link(index);
+            active_count++;
+
+            // the timing thread sleeps longer than this timer
+            if (node.expires < next_wake_tick)
+                condition.notify();
+
+            TimerHandle handle;
+            handle.index = index;
+            handle.generation = node.generation;
+            return handle;
+        }
+
+    public:
+        // deleted copy constructor and assign operator, to avoid copy...
+        TimerWheel(const TimerWheel &v) = delete;
+        TimerWheel &operator=(const TimerWheel &v) = delete;
+
+        /// \brief Construct the wheel and start the timing thread
+        ///
+        /// \param pool the pool that runs the expired callbacks. If nullptr, the callbacks run in the timing thread.
+        /// \param tick_ms wheel resolution
+        ///
+        TimerWheel(ThreadPool *pool = nullptr, uint32_t tick_ms = 1)
+        {
+            if (tick_ms == 0)
+                tick_ms = 1;
+            this->pool = pool;
+            tick_us = (uint64_t)tick_ms * UINT64_C(1000);
+            current_tick = 0;
+            next_wake_tick = UINT64_MAX;
+            active_count = 0;
+            for (uint32_t i = 0; i < SLOT_COUNT; i++)
+                slots[i] = NONE;
+
+            thread = new Platform::Thread(EventCore::CallbackWrapper(&TimerWheel::run, this));
+            thread->start();
+        }
+
+        ~TimerWheel()
+        {
+            thread->interrupt();
+            thread->wait();
+            delete thread;
+            thread = nullptr;
+        }
+
+        /// \brief Run the callback once, after delay_ms
+        ///
+        TimerHandle postDelayed(uint32_t delay_ms, const CallbackType &callback)
+        {
+            return add(delay_ms, 0, callback);
+        }
+
+        /// \brief Run the callback every period_ms
+        ///
+        /// \param first_delay_ms delay of the first execution. UINT32_MAX uses the period.
+        ///
+        TimerHandle postPeriodic(uint32_t period_ms, const CallbackType &callback, uint32_t first_delay_ms = UINT32_MAX)
+        {
+            if (first_delay_ms == UINT32_MAX)
+                first_delay_ms = period_ms;
+            return add(first_delay_ms, period_ms, callback);
+        }
+
+        /// \brief Remove a timer
+        ///
+        /// \return false if the timer already expired (one shot) or was already canceled
+        ///
+        bool cancel(const TimerHandle &handle)
+        {
+            Platform::AutoLock autoLock(&mutex);
+            if (handle.index >= (uint32_t)nodes.size())
+                return false;
+            TimerNode &node = nodes[handle.index];
+            if (!node.active || node.generation != handle.generation)
+                return false;
+            unlink(handle.index);
+            freeNode(handle.index);
+            return true;
+        }
+
+        // number of active timers
+        uint32_t size()
+        {
+            Platform::AutoLock autoLock(&mutex);
+            return active_count;
+        }
+    };
+
+}
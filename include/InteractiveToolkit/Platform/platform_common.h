@@ -131,6 +131,17 @@ namespace ITKPlatformUtil
 // shared memory
 #include <sys/mman.h>
 
+// Fiber
+#include <poll.h>
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+// the deprecated ucontext routines require _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#include <ucontext.h>
+#undef _XOPEN_SOURCE
+#else
+#include <ucontext.h>
+#endif
+
 #undef closesocket
 #define closesocket(s) close(s)
 
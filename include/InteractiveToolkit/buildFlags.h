@@ -0,0 +1,30 @@
+#pragma once
+
+// "For this is how God loved the world:
+// he gave his only Son, so that everyone
+// who believes in him may not perish
+// but may have eternal life."
+//
+// John 3:16
+
+#ifndef ITK_OPENMP
+#    define ITK_OPENMP
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(i386) || defined(__i386__) || defined(__i386) || defined(_M_IX86)
+#    ifndef ITK_SSE2
+#        define ITK_SSE2
+#    endif
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(i386) || defined(__i386__) || defined(__i386) || defined(_M_IX86)
+#    ifndef ITK_AVX2
+#        define ITK_AVX2
+#    endif
+#endif
+#ifndef ITK_TRIGONOMETRIC_FAST_LESS_MEMORY
+#    define ITK_TRIGONOMETRIC_FAST_LESS_MEMORY
+#endif
+#ifndef ITK_FLOAT_ALMOST_EQUAL_USE_ONLY_RELATIVE
+#    define ITK_FLOAT_ALMOST_EQUAL_USE_ONLY_RELATIVE
+#endif
+
+
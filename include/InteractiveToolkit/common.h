@@ -18,6 +18,7 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <algorithm>
 #include <functional>
@@ -39,6 +40,11 @@
 #define ITK_INLINE inline __attribute__((always_inline))
 #endif
 
+// used to pad atomics written by different threads (avoid false sharing)
+#ifndef ITK_CACHE_LINE_SIZE
+#define ITK_CACHE_LINE_SIZE 64
+#endif
+
 #if defined(_WIN32)
 
 #define WIN32_LEAN_AND_MEAN
@@ -0,0 +1,28 @@
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "$<$<AND:$<NOT:$<COMPILE_LANGUAGE:CUDA>>,$<COMPILE_LANGUAGE:C>>:-fopenmp>")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "$<$<AND:$<NOT:$<COMPILE_LANGUAGE:CUDA>>,$<COMPILE_LANGUAGE:CXX>>:-fopenmp>")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-mmmx")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-msse")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-msse2")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-msse3")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-msse4.1")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-mavx")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-mavx2")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-mfpmath=sse")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-minline-all-stringops")
+    list(APPEND INTERACTIVETOOLKIT_COMPILE_OPTIONS "-finline-functions")
+
+    list(APPEND INTERACTIVETOOLKIT_LIBRARIES "$<$<NOT:$<LINK_LANGUAGE:CUDA>>:/usr/lib/gcc/x86_64-linux-gnu/12/libgomp.so>")
+    list(APPEND INTERACTIVETOOLKIT_LIBRARIES "$<$<NOT:$<LINK_LANGUAGE:CUDA>>:/usr/lib/x86_64-linux-gnu/libpthread.a>")
+    list(APPEND INTERACTIVETOOLKIT_LIBRARIES "pthread")
+    list(APPEND INTERACTIVETOOLKIT_LIBRARIES "rt")
+
+
+
+    set(ITK_RPI OFF)
+    set(ITK_NEON OFF)
+    set(ITK_OPENMP ON)
+    set(ITK_SSE2 ON)
+    set(ITK_AVX2 ON)
+    set(ITK_SSE_SKIP_SSE41 OFF)
+    set(ITK_FORCE_USE_RSQRT_CARMACK OFF)
+